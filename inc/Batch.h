@@ -0,0 +1,118 @@
+/**
+ * This file declares 'Batch' class that stegs or unstegs many images in one process.
+ * Images go through a pipeline of stages (decode -> embed or extract -> encode), each one run by a pool of worker
+ * threads and connected to the next one by a bounded queue, so decoding, embedding and encoding of different images
+ * overlap while only a few decoded images are in memory at a time.
+ * The key schedule (and SHA-1 digest) of a key is built once and shared by all the images using it.
+ */
+
+ #ifndef BATCH_H
+ #define BATCH_H
+
+ #include <string>
+ #include <vector>
+ #include <map>
+ #include <memory>
+ #include <mutex>
+ #include <iostream>
+ #include "KeySchedule.h"
+ #include "MatImage.h"
+
+ namespace Steganography
+ {
+ 	/** One image of a batch */
+ 	struct BatchItem
+ 		{
+ 			std::string image;		// The image to steg or unsteg
+ 			std::string payload;	// The file to hide (steg only)
+ 			std::string key;		// The password
+ 			std::string output;		// The stego-image (steg) or the file extracted (unsteg)
+ 		};
+
+ 	/** Totals of a batch */
+ 	struct BatchSummary
+ 		{
+ 			size_t done;			// Number of images processed successfully
+ 			size_t failed;			// Number of images that failed
+ 			uint64_t bytes;			// Number of payload bytes hidden or extracted
+ 			double seconds;			// Time taken by the whole batch
+ 		};
+
+ 	class Batch
+ 		{
+ 			public :
+ 				/** What to do with every image */
+ 				enum Mode { STEG, UNSTEG };
+
+ 			private :
+ 				Mode mMode;
+
+ 				/** Number of worker threads of each stage */
+ 				unsigned mWorkers;
+
+ 				/** Number of images that can wait between two stages */
+ 				size_t mQueue;
+
+ 				/** Whether every stego-image is decoded again and checked once saved, see 'set_verify()' */
+ 				bool mVerify = false;
+
+ 				/** How every image is stegged, see 'set_options()' */
+ 				StegOptions mOptions;
+
+ 				/** Key schedules already built, by key */
+ 				std::map<std::string, std::shared_ptr<const KeySchedule> > mSchedules;
+ 				std::mutex mSchedulesMutex;
+
+ 				/** Returns the key schedule of the key, building it only the first time */
+ 				std::shared_ptr<const KeySchedule> schedule(const std::string& key);
+
+ 			public :
+ 				/**
+ 				 * Creates a batch
+ 				 * @param	mode		Steg or unsteg
+ 				 * @param	workers		Number of worker threads of each stage, 0 for the number of cores
+ 				 */
+ 				Batch(Mode mode, unsigned workers = 0);
+
+ 				/**
+ 				 * Checks every stego-image once saved (steg only): its payload rows are decoded again and must hold the
+ 				 * same bits as the image they were saved from ('MatImage::fingerprint()'), or the item fails.
+ 				 * An output of a lossy format fails before its image is decoded, with or without it.
+ 				 */
+ 				void set_verify(bool on = true);
+
+ 				/**
+ 				 * Sets the options of 'steg()', the same for every image (steg only), see 'MatImage::set_options()'.
+ 				 * The default ones hide the text as it is, 1 bit per sample.
+ 				 */
+ 				void set_options(const StegOptions& options);
+
+ 				/**
+ 				 * Reads a manifest, i.e. a text file with one image per line and tab-separated fields:
+ 				 *   steg		:	IMAGE	PAYLOAD	KEY	OUTPUT
+ 				 *   unsteg	:	IMAGE	KEY	OUTPUT
+ 				 * Empty lines and lines starting with '#' are skipped. Throws 'IOError' for a malformed manifest.
+ 				 */
+ 				static std::vector<BatchItem> manifest(const std::string& filename, Mode mode);
+
+ 				/**
+ 				 * Lists the images of a directory, all with the same payload (steg only) and key. Outputs are named
+ 				 * after the images in directory 'outdir', with extension '.png' for steg and '.txt' for unsteg.
+ 				 */
+ 				static std::vector<BatchItem> directory(const std::string& dir, const std::string& payload,
+ 														const std::string& key, const std::string& outdir, Mode mode);
+
+ 				/**
+ 				 * Processes all the items, writing one status line per item and the totals to 'report'. An item fails
+ 				 * without being processed if its output is an image or payload of the batch, or the output of another
+ 				 * item (compared by inode for the files that exist). JPEG images are unstegged from their DCT
+ 				 * coefficients, like 'JpegImage::unsteg()'.
+ 				 * @return	The totals
+ 				 */
+ 				BatchSummary run(const std::vector<BatchItem>& items, std::ostream& report);
+
+ 		};	// class 'Batch' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'BATCH_H' closed.
@@ -0,0 +1,68 @@
+/**
+ * This file defines 'BoundedQueue' class, the queue between two stages of a pipeline ('Batch' and 'Pipeline'): a
+ * stage waits on it when the next one is behind, so the items in flight, and the memory they take, are bounded.
+ */
+
+ #ifndef BOUNDEDQUEUE_H
+ #define BOUNDEDQUEUE_H
+
+ #include <deque>
+ #include <mutex>
+ #include <utility>
+ #include <cstddef>
+ #include <condition_variable>
+
+ namespace Steganography
+ {
+ 	/** A queue between two stages, 'push()' waits while it is full and 'pop()' while it is empty */
+ 	template<class T>
+ 	class BoundedQueue
+ 		{
+ 			private :
+ 				std::deque<T> mItems;
+ 				std::size_t mCapacity;
+ 				bool mClosed;
+ 				std::mutex mMutex;
+ 				std::condition_variable mNotFull, mNotEmpty;
+
+ 			public :
+ 				BoundedQueue(std::size_t capacity) : mCapacity(capacity), mClosed(false) {}
+
+ 				// Returns false if the queue is closed, the item is then dropped
+ 				bool push(T item)
+ 					{
+ 						std::unique_lock<std::mutex> lock(mMutex);
+ 						mNotFull.wait(lock, [this]{ return mItems.size() < mCapacity or mClosed; });
+ 						if(mClosed)
+ 							return false;
+ 						mItems.push_back(std::move(item));
+ 						mNotEmpty.notify_one();
+ 						return true;
+ 					}
+
+ 				// Returns false once the queue is closed and empty
+ 				bool pop(T& item)
+ 					{
+ 						std::unique_lock<std::mutex> lock(mMutex);
+ 						mNotEmpty.wait(lock, [this]{ return not mItems.empty() or mClosed; });
+ 						if(mItems.empty())
+ 							return false;
+ 						item = std::move(mItems.front());
+ 						mItems.pop_front();
+ 						mNotFull.notify_one();
+ 						return true;
+ 					}
+
+ 				// No more items will be pushed, the ones already in may still be popped
+ 				void close()
+ 					{
+ 						std::lock_guard<std::mutex> lock(mMutex);
+ 						mClosed = true;
+ 						mNotEmpty.notify_all();
+ 						mNotFull.notify_all();
+ 					}
+ 		};	// class 'BoundedQueue' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'BOUNDEDQUEUE_H' closed.
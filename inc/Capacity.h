@@ -0,0 +1,80 @@
+/**
+ * This file declares the capacity planner, that sizes carriers before they are decoded.
+ * 'MatImage' only finds out that a text does not fit once the whole image is decoded. The capacity of an image only
+ * depends on its size though, which is in the first bytes of the file: 'probe()' reads them alone for PNG, JPEG, PNM
+ * (PPM, PGM, PBM, PAM) and BMP files, so an image too small costs a few hundred bytes read instead of a decode.
+ * 'pick()' probes a pool of images at once and returns the smallest one a payload fits in.
+ */
+
+ #ifndef CAPACITY_H
+ #define CAPACITY_H
+
+ #include <string>
+ #include <vector>
+ #include <cstdint>
+ #include <cstddef>
+ #include "MatImage.h"
+
+ namespace Steganography
+ {
+ 	namespace capacity
+ 	{
+ 		/** What the header of an image file tells */
+ 		struct Carrier
+ 			{
+ 				std::string filename;
+ 				long cols = 0;				// Number of pixels in a row
+ 				long rows = 0;				// Number of rows
+ 				int channels = 0;			// Samples per pixel in the file (1 for a palette), 3 once decoded
+ 				int bps = 0;				// Bits per sample in the file, 8 once decoded
+ 				bool coefficients = false;	// Whether it is a JPEG file, that 'JpegImage' can hide in
+ 				long dct = -1;				// Bytes 'JpegImage' can hide in it, -1 unless 'probe()' counted them
+ 				bool decoded = false;		// Whether its header was not known and it was decoded to get its size
+ 				std::string error;			// Why it could not be probed, empty if it was
+ 			};
+
+ 		/**
+ 		 * Reads the size of an image from its header, decoding it only if its format is not one of the above.
+ 		 * With 'coefficients' the coefficients of a JPEG file are read too (with no IDCT) and those 'JpegImage' can
+ 		 * hide in are counted, once, into 'dct'. Throws 'IOError' if it can't be read.
+ 		 */
+ 		Carrier probe(const std::string& filename, bool coefficients = false);
+
+ 		/**
+ 		 * Probes many images on 'threads' threads (0 for one per core), in the order of the file names. An image
+ 		 * that can't be read has its 'error' set instead of throwing.
+ 		 */
+ 		std::vector<Carrier> probe(const std::vector<std::string>& filenames, unsigned threads = 0,
+ 								   bool coefficients = false);
+
+ 		/**
+ 		 * Returns the largest payload, as it is stored i.e. once compressed (see 'packed()'), that 'steg()' can hide
+ 		 * in the carrier with the options: 'depth' bytes per 3 pixels after the first row, less the header and the
+ 		 * envelope of the cipher. 0 for an image of less than 80 pixels per row.
+ 		 * With 'coefficients' a JPEG file is sized for 'JpegImage' from the count of 'probe()', throws 'Error' if
+ 		 * its coefficients were not counted.
+ 		 */
+ 		uint64_t capacity(const Carrier& carrier, const StegOptions& options, bool coefficients = false);
+
+ 		/** Returns the size of the payload compressed as 'steg()' would with the options, compared to 'capacity()' */
+ 		uint64_t packed(const uint8_t* data, std::size_t size, const StegOptions& options);
+
+ 		/**
+ 		 * Returns the carrier of the smallest capacity a payload of 'stored' bytes (see 'packed()') fits in, or null
+ 		 * if it fits in none. With 'coefficients' the JPEG files must have been probed with it too.
+ 		 */
+ 		const Carrier* smallest(const std::vector<Carrier>& carriers, uint64_t stored, const StegOptions& options,
+ 								bool coefficients = false);
+
+ 		/**
+ 		 * Probes a pool of images and returns the smallest one the payload fits in with the options, compressing it
+ 		 * once. Returns an empty string if it fits in none.
+ 		 */
+ 		std::string pick(const std::vector<std::string>& pool, const uint8_t* data, std::size_t size,
+ 						 const StegOptions& options, unsigned threads = 0);
+
+ 	}	// namespace 'capacity' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'CAPACITY_H' closed.
@@ -0,0 +1,118 @@
+/**
+ * This file declares the authenticated encryption of the payload, see 'MatImage::set_encryption()'.
+ * The key is derived from the password with PBKDF2 (HMAC-SHA256) and a random salt, and the payload is encrypted with
+ * AES-256-GCM or ChaCha20-Poly1305 through OpenSSL's EVP, which uses AES-NI (or the vector units for ChaCha20) when
+ * the processor has them. An encrypted payload starts with an 'Envelope' holding everything but the password needed
+ * to decrypt it: the algorithm, the KDF iterations, the salt, the nonce and the tag. The 'Header' of the payload and
+ * the algorithm and iterations of the envelope are authenticated with it (as associated data), so none of them can be
+ * changed unnoticed either.
+ * The header of an encrypted payload is itself hidden under a key derived from the password ('mask()'), with its salt
+ * in clear in the first row instead of the digest of the password. Only the key schedule, which is cheap to build,
+ * would be needed to read it otherwise, so a password could be checked without the KDF.
+ * Encryption and decryption go chunk by chunk, so they overlap with hiding and reading the payload.
+ */
+
+ #ifndef CIPHER_H
+ #define CIPHER_H
+
+ #include <string>
+ #include <cstdint>
+ #include <cstddef>
+ #include "Header.h"
+
+ typedef struct evp_cipher_ctx_st EVP_CIPHER_CTX;
+
+ namespace Steganography
+ {
+ 	namespace crypto
+ 	{
+ 		/** The algorithms, their values are the ones stored in an envelope */
+ 		enum Algorithm { NONE = 0, AES_256_GCM = 1, CHACHA20_POLY1305 = 2 };
+
+ 		/** The prefix of an encrypted payload */
+ 		struct Envelope
+ 			{
+ 				/** Size (in bytes) of the envelope */
+ 				static const std::size_t SIZE = 52;
+
+ 				/** Default and maximum numbers of iterations of the KDF */
+ 				static const uint32_t ITERATIONS = 100000;
+ 				static const uint32_t MAX_ITERATIONS = 10000000;
+
+ 				Algorithm algorithm;
+ 				uint32_t iterations;
+ 				uint8_t salt[16];
+ 				uint8_t nonce[12];
+ 				uint8_t tag[16];
+
+ 				/**
+ 				 * Writes the envelope as 'SIZE' bytes:
+ 				 * algorithm (1), reserved (3), iterations (4, little-endian), salt (16), nonce (12), tag (16)
+ 				 */
+ 				void write(uint8_t* out) const;
+
+ 				/** Reads an envelope from 'SIZE' bytes, throws 'Error' if its algorithm or iterations are invalid */
+ 				void read(const uint8_t* in);
+ 			};
+
+ 		/** Returns the name of an algorithm, e.g. to report it */
+ 		std::string name(Algorithm a);
+
+ 		/** Returns the algorithm of the given name ("aes-256-gcm" or "chacha20-poly1305"), throws 'Error' if unknown */
+ 		Algorithm algorithm(const std::string& name);
+
+ 		/** Returns AES-256-GCM if the processor accelerates it, ChaCha20-Poly1305 otherwise */
+ 		Algorithm preferred();
+
+ 		/** Fills 'size' bytes with random ones from OpenSSL's generator, throws 'Error' if it fails */
+ 		void random(uint8_t* out, std::size_t size);
+
+ 		/**
+ 		 * Masks (or unmasks, it is a XOR) the 'Header::SIZE' bytes of the header of an encrypted payload with a key
+ 		 * derived from the password and the 16 bytes of 'salt' by PBKDF2 with 'Envelope::ITERATIONS' iterations: the
+ 		 * iterations of the envelope are only known once the header is read. Throws 'Error' if OpenSSL fails.
+ 		 */
+ 		void mask(const std::string& password, const uint8_t* salt, uint8_t* header);
+
+ 		/** Encrypts or decrypts one payload, chunk by chunk */
+ 		class Cipher
+ 			{
+ 				public :
+ 					enum Direction { ENCRYPT, DECRYPT };
+
+ 				private :
+ 					Direction mDirection;
+ 					EVP_CIPHER_CTX* mCtx;
+
+ 				public :
+ 					/**
+ 					 * Derives the key and starts
+ 					 * @param	d			The direction
+ 					 * @param	password	The password
+ 					 * @param	e			The envelope: to encrypt, its algorithm and iterations are used and its salt
+ 					 *						and nonce are drawn at random; to decrypt, it is the one read
+ 					 * @param	h			The header of the payload, with its flags set. Its length is not
+ 					 *						authenticated, the ciphertext is: it may be set once the payload is known.
+ 					 * Throws 'Error' if OpenSSL fails.
+ 					 */
+ 					Cipher(Direction d, const std::string& password, Envelope& e, const Header& h);
+ 					~Cipher();
+
+ 					Cipher(const Cipher&) = delete;
+ 					Cipher& operator=(const Cipher&) = delete;
+
+ 					/** Encrypts or decrypts the next 'size' bytes of the payload, 'out' may be 'in' */
+ 					void update(const uint8_t* in, uint8_t* out, std::size_t size);
+
+ 					/**
+ 					 * Ends the payload: stores the tag in the envelope when encrypting, checks it when decrypting.
+ 					 * Throws 'Error' if the tag does not match i.e. the payload was modified.
+ 					 */
+ 					void finish(Envelope& e);
+ 			};	// class 'Cipher' closed.
+
+ 	}	// namespace 'crypto' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'CIPHER_H' closed.
@@ -0,0 +1,77 @@
+/**
+ * This file declares the codecs that may compress a payload before it is hidden, see 'MatImage::set_compression()'.
+ * Hiding costs a group of 3 pixels per byte, so a text compressed 4 times needs 4 times less pixels and time.
+ * A compressed payload starts with a 'Frame' telling its codec, level and original size, so that 'unsteg()'
+ * decompresses it without being told anything.
+ * zlib is always available, zstd and LZ4 only when built with 'HAVE_ZSTD' and 'HAVE_LZ4' (see the Makefile).
+ */
+
+ #ifndef COMPRESSION_H
+ #define COMPRESSION_H
+
+ #include <string>
+ #include <vector>
+ #include <cstdint>
+ #include <cstddef>
+
+ namespace Steganography
+ {
+ 	namespace compression
+ 	{
+ 		/** The codecs, their values are the ones stored in a frame */
+ 		enum Codec { NONE = 0, ZLIB = 1, ZSTD = 2, LZ4 = 3 };
+
+ 		/** The prefix of a compressed payload */
+ 		struct Frame
+ 			{
+ 				/** Size (in bytes) of the frame */
+ 				static const std::size_t SIZE = 12;
+
+ 				/** Largest size of the data once decompressed, so that a forged frame can't make 'unsteg()' allocate more */
+ 				static const uint64_t MAX_RAW = uint64_t(1) << 30;
+
+ 				Codec codec;		// Codec of the data following the frame
+ 				int8_t level;		// Level it was compressed with, only to report it
+ 				uint64_t raw;		// Size (in bytes) of the data once decompressed
+
+ 				/** Writes the frame as 'SIZE' bytes: codec (1), level (1), reserved (2), raw (8, little-endian) */
+ 				void write(uint8_t* out) const;
+
+ 				/** Reads a frame from 'SIZE' bytes, throws 'Error' if its codec is unknown or not available */
+ 				void read(const uint8_t* in);
+ 			};
+
+ 		/** Whether the codec was built in */
+ 		bool available(Codec c);
+
+ 		/** Returns the name of a codec, e.g. to report it */
+ 		std::string name(Codec c);
+
+ 		/** Returns the codec of the given name ("none", "zlib", "zstd" or "lz4"), throws 'Error' if it is not available */
+ 		Codec codec(const std::string& name);
+
+ 		/** Returns the level used when none is given (i.e. 0) */
+ 		int default_level(Codec c);
+
+ 		/**
+ 		 * Compresses data
+ 		 * @param	c		The codec, other than 'NONE'
+ 		 * @param	level	Its level, 0 for the default one
+ 		 * @return			The frame followed by the compressed data
+ 		 * Throws 'Error' for more than 'Frame::MAX_RAW' bytes.
+ 		 */
+ 		std::vector<uint8_t> compress(Codec c, int level, const uint8_t* data, std::size_t size);
+
+ 		/**
+ 		 * Decompresses data written by 'compress()'
+ 		 * @return			The original data
+ 		 * Throws 'Error' if the data is corrupted or its codec is not available, before allocating anything if the
+ 		 * size in its frame is more than the data can decompress to.
+ 		 */
+ 		std::string decompress(const uint8_t* data, std::size_t size);
+
+ 	}	// namespace 'compression' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'COMPRESSION_H' closed.
@@ -47,6 +47,12 @@ namespace Steganography
 			KeyMismatchError(const std::string& msg = " Incorrect password ! ");
 		};
 		
+	/** For handling a request for bytes beyond the hidden payload */
+	struct RangeError : public Error
+		{
+			RangeError(const std::string& msg = " The range is beyond the hidden text ! ");
+		};
+		
 	/** For handling I/O error */
 	struct IOError : public Error
 		{
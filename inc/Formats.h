@@ -0,0 +1,49 @@
+/**
+ * This file declares the registry of the image formats a stego-image can be saved to, by extension.
+ * A text is hidden in the lowest bits of the samples, so a format has to keep every bit of 8-bit RGB samples for the
+ * stego-image to hold it: a lossy codec (JPEG, WebP) or a format of less samples (gray, palette) destroys it, and this
+ * is only found out when 'unsteg' fails. 'steg' checks the stego-image with 'check()' before doing anything else.
+ * A JPEG stego-image of a JPEG image is the exception: 'JpegImage' hides the text in its coefficients, not its pixels.
+ */
+
+ #ifndef FORMATS_H
+ #define FORMATS_H
+
+ #include <string>
+
+ namespace Steganography
+ {
+ 	namespace formats
+ 	{
+ 		/** What a format does with the pixels */
+ 		struct Format
+ 			{
+ 				const char* name;			// e.g. "PNG"
+ 				const char* extensions;		// Its extensions, lower case and separated by spaces
+ 				bool lossless;				// Whether every bit of 8-bit RGB samples is kept
+ 				bool mapped;				// Whether 'ImageMap' maps it i.e. it can be updated in place
+ 				bool streamed;				// Whether 'RowWriter' encodes it row by row
+ 				bool coefficients;			// Whether 'JpegImage' hides in its DCT coefficients, keeping it as it is
+ 				const char* loss;			// What destroys the hidden text, for a lossy format
+ 			};
+
+ 		/** Returns the format of a file by its extension (case insensitive), or null if it is not known */
+ 		const Format* find(const std::string& filename);
+
+ 		/** Returns whether a file of the given name keeps every bit of the pixels saved to it */
+ 		bool lossless(const std::string& filename);
+
+ 		/** Returns the file name with its extension replaced by ".png", the default lossless format */
+ 		std::string lossless_name(const std::string& filename);
+
+ 		/**
+ 		 * Throws 'Error' unless a stego-image can be saved to a file of the given name, telling why and which
+ 		 * name to use instead
+ 		 */
+ 		void check(const std::string& filename);
+
+ 	}	// namespace 'formats' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'FORMATS_H' closed.
@@ -0,0 +1,64 @@
+/**
+ * This file declares the digests of the keys, the ones hidden in the first row of a stego-image.
+ * They go through OpenSSL's EVP with a context kept per thread, so hashing allocates nothing, and the digests of
+ * passwords are kept in a small cache shared by the process: a batch of thousands of images with a handful of keys
+ * hashes each key once. SHA-1 is the default (and the only one of older images), SHA-256 and BLAKE2b can be chosen
+ * with 'MatImage::set_digest()' and are then recorded in the header. Every digest is cut to the 20 bytes of 'Digest'.
+ */
+
+ #ifndef HASH_H
+ #define HASH_H
+
+ #include <string>
+ #include <cstddef>
+ #include "util.h"
+
+ typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+ namespace Steganography
+ {
+ 	namespace hashing
+ 	{
+ 		/** The algorithms, their values are the ones stored in a header */
+ 		enum Algorithm { SHA1 = 0, SHA256 = 1, BLAKE2B = 2 };
+
+ 		/** Returns the name of an algorithm ("sha1", "sha256" or "blake2b") */
+ 		std::string name(Algorithm a);
+
+ 		/** Returns the algorithm of the given name, throws 'Error' if it is unknown */
+ 		Algorithm algorithm(const std::string& name);
+
+ 		/** A streaming digest, whose EVP context is reused from one digest to the next */
+ 		class Context
+ 			{
+ 				private :
+ 					EVP_MD_CTX* mCtx;
+
+ 				public :
+ 					Context();
+ 					~Context();
+
+ 					Context(const Context&) = delete;
+ 					Context& operator=(const Context&) = delete;
+
+ 					/** Starts a new digest, throws 'Error' if OpenSSL fails */
+ 					void start(Algorithm a);
+
+ 					/** Hashes the next bytes */
+ 					void update(const void* data, std::size_t size);
+
+ 					/** Ends the digest and returns its first 20 bytes */
+ 					Digest finish();
+ 			};	// class 'Context' closed.
+
+ 		/** Returns the digest of the bytes, with a context of the calling thread */
+ 		Digest compute(Algorithm a, const void* data, std::size_t size);
+
+ 		/** Returns the digest of a password, from the cache of the process when it was already computed */
+ 		Digest password(Algorithm a, const std::string& key);
+
+ 	}	// namespace 'hashing' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'HASH_H' closed.
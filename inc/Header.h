@@ -0,0 +1,62 @@
+/**
+ * This file declares 'Header' struct i.e. the header hidden at the start of the second row of a stego-image, just
+ * before the payload.
+ * It begins with a '\0' byte, which is how images of the older format (the text followed by a '\0', with no header)
+ * are told apart: they never hide an empty text.
+ */
+
+ #ifndef HEADER_H
+ #define HEADER_H
+
+ #include <cstdint>
+ #include <cstddef>
+
+ namespace Steganography
+ {
+ 	struct Header
+ 		{
+ 			/** Size (in bytes) of the header */
+ 			static const std::size_t SIZE = 16;
+ 			
+ 			/** The current version of the format */
+ 			static const uint8_t VERSION = 1;
+ 			
+ 			/** The first 4 bytes of every header */
+ 			static const uint8_t MAGIC[4];
+ 			
+ 			/** Flags, set only for options not used by default so that older readers refuse the image */
+ 			static const uint8_t MULTIBIT = 1;		// The payload uses more than 1 bit per sample, see 'depth'
+ 			static const uint8_t SCATTER = 2;		// The payload is spread over the image by the key
+ 			static const uint8_t COMPRESSED = 4;	// The payload is compressed, see 'Compression.h'
+ 			static const uint8_t ENCRYPTED = 8;		// The payload is encrypted, see 'Cipher.h'
+ 			
+ 			/** All the flags known */
+ 			static const uint8_t FLAGS = MULTIBIT | SCATTER | COMPRESSED | ENCRYPTED;
+ 			
+ 			uint8_t version;	// Version of the format
+ 			uint8_t flags;		// Options used to hide the payload
+ 			uint8_t depth;		// Number of bits of the payload per sample (1 to 4)
+ 			uint8_t digest;		// Algorithm of the digest of the key in the first row, see 'hashing::Algorithm'
+ 			uint64_t length;	// Size (in bytes) of the payload
+ 			
+ 			/** Creates the header of a payload of the given size */
+ 			Header(uint64_t length = 0, uint8_t depth = 1, bool scattered = false);
+ 			
+ 			/**
+ 			 * Writes the header as 'SIZE' bytes:
+ 			 * magic (4 bytes), version (1), flags (1), depth (1, 0 for 1), digest (1), length (8, little-endian)
+ 			 * The header itself is always hidden with 1 bit per sample.
+ 			 */
+ 			void write(uint8_t* out) const;
+ 			
+ 			/**
+ 			 * Reads a header from 'SIZE' bytes
+ 			 * @return	false if the bytes are not a header i.e. the image is of the older format
+ 			 * Throws 'Error' for a header of an unknown version or with unknown flags.
+ 			 */
+ 			bool read(const uint8_t* in);
+ 		};	// struct 'Header' closed.
+ 		
+ }	// namespace 'Steganography' closed.
+ 
+ #endif	// 'HEADER_H' closed.
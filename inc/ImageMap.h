@@ -0,0 +1,97 @@
+/**
+ * This file declares 'ImageMap' class that memory-maps an uncompressed image file, so that its pixels are used in
+ * place instead of being decoded into a new buffer and encoded again.
+ * Binary PPM ('P6'), PAM ('P7', RGB) and uncompressed 24-bit BMP files of 8-bit samples are mapped this way. The rows
+ * of a bottom-up BMP (the usual ones) are in reverse order, so they can be accessed with 'row()' but are not one
+ * image with a positive step as 'pixels()' is.
+ * With a shared mapping the text is hidden in the file itself: only the pages of the rows touched are read and
+ * written back, so the cost follows the size of the text and not the one of the image.
+ */
+
+ #ifndef IMAGEMAP_H
+ #define IMAGEMAP_H
+
+ #include <string>
+ #include <memory>
+ #include <cstdint>
+ #include <cstddef>
+ #include "bitplane.h"
+
+ namespace Steganography
+ {
+ 	class ImageMap
+ 		{
+ 			public :
+ 				/** How changes to the pixels reach the file */
+ 				enum Mode
+ 					{
+ 						PRIVATE,	// Copy-on-write, the file only changes if it is saved to
+ 						SHARED		// The file changes as the pixels do
+ 					};
+
+ 				/** The formats that can be mapped */
+ 				enum Format { PPM, PAM, BMP };
+
+ 			private :
+ 				Mode mMode;
+ 				Format mFormat;
+
+ 				/** The whole file mapped, and its identity to recognize it when saving */
+ 				uint8_t* mAddr;
+ 				size_t mSize;
+ 				uint64_t mDevice;
+ 				uint64_t mInode;
+
+ 				/** The pixels in it */
+ 				size_t mOffset;
+ 				int mCols;
+ 				int mRows;
+ 				size_t mStep;
+ 				ChannelOrder mOrder;
+ 				bool mBottomUp;
+
+ 				ImageMap(Mode mode, uint8_t* addr, size_t size);
+
+ 				/** Reads the header of the file, returns false if it is not of a format that can be mapped */
+ 				bool parse();
+
+ 			public :
+ 				/**
+ 				 * Maps an image file
+ 				 * @return	The mapping, or null if the file can't be opened or its format can't be mapped
+ 				 */
+ 				static std::shared_ptr<ImageMap> open(const std::string& filename, Mode mode = PRIVATE);
+
+ 				/** Unmaps the file, changes of a shared mapping are still written back by the system */
+ 				~ImageMap();
+
+ 				ImageMap(const ImageMap&) = delete;
+ 				ImageMap& operator=(const ImageMap&) = delete;
+
+ 				/** Getters */
+
+ 				Mode mode() const;  // Returns how the file is mapped
+ 				Format format() const;  // Returns the format of the file
+ 				uint8_t * pixels() const;  // Returns the pointer to the first row, of a top-down image only
+ 				uint8_t * row(int r) const;  // Returns the pointer to the row 'r' (counted from the top)
+ 				bool bottom_up() const;  // Whether the rows are stored from the bottom one
+ 				int cols() const;  // Returns the number of pixels in a row
+ 				int rows() const;  // Returns the number of rows
+ 				size_t step() const;  // Returns the number of bytes between 2 rows
+ 				ChannelOrder order() const;  // Returns the order of the channels
+
+ 				/**
+ 				 * Saves the mapped image: a shared mapping of the same file is only flushed with 'msync()', to another
+ 				 * file of the same format (by its extension) the mapping is written as it is. Throws 'IOError' if the
+ 				 * file can't be written.
+ 				 * @return	False if the file has another format, so it has to be encoded
+ 				 */
+ 				bool save(const std::string& filename) const;
+ 				
+ 				/** Writes the changes of a shared mapping to the file, throws 'IOError' if it fails */
+ 				void sync() const;
+ 		};	// class 'ImageMap' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'IMAGEMAP_H' closed.
@@ -0,0 +1,98 @@
+/**
+ * This file declares 'JpegImage' class that hides a text in the quantized DCT coefficients of a JPEG file, the
+ * counterpart of 'MatImage' for JPEG carriers.
+ * The coefficients are read and written with libjpeg's coefficient API ('jpeg_read_coefficients()' and
+ * 'jpeg_write_coefficients()'), so there is no IDCT, no color conversion and no quantization again: the stego-image is
+ * a JPEG file of about the size of the image, every coefficient but the ones carrying the text being the same.
+ * Each bit goes to the lowest bit of the magnitude of an AC coefficient, the blocks of 8x8 coefficients being taken in
+ * the order of a permutation seeded by the key (see 'Permutation.h'). Coefficients of magnitude 0 and 1 are skipped,
+ * since changing them would change which coefficients carry bits: a magnitude of 2 or more stays so and the reader
+ * finds the same ones.
+ * The bits are those of a 'Header' (with 'Header::SCATTER'), the digest of the key, then the payload.
+ */
+
+ #ifndef JPEGIMAGE_H
+ #define JPEGIMAGE_H
+
+ #include <string>
+ #include <memory>
+ #include <cstdint>
+ #include <cstddef>
+ #include "MatImage.h"
+ #include "KeySchedule.h"
+
+ namespace Steganography
+ {
+ 	class JpegImage
+ 		{
+ 			private :
+ 				/** The decompressor holding the coefficients, and the blocks of all the components */
+ 				struct Coefficients;
+ 				std::unique_ptr<Coefficients> mCoefficients;
+
+ 				/** How 'steg()' hides the text, only 'depth' 1 and no 'scatter' (it is always spread) */
+ 				StegOptions mOptions;
+
+ 				/** What the last 'steg()' did */
+ 				StegReport mReport = StegReport();
+
+ 				/** Number of coefficients that can carry a bit */
+ 				uint64_t mUsable = 0;
+
+ 				/** Returns the payload as it is stored, throws 'KeyMismatchError' if the key doesn't match */
+ 				std::string stored(Header& h, const KeySchedule& ks) const;
+
+ 			public :
+ 				/** Number of bytes before the payload, the header and the digest of the key */
+ 				static const std::size_t PREFIX = Header::SIZE + sizeof(Digest);
+
+ 				/** Returns whether a file of the given name is a JPEG file (by its extension, see 'formats::Format') */
+ 				static bool supported(const std::string& filename);
+
+ 				/** Reads the coefficients of a JPEG file, throws 'IOError' if it can't be read */
+ 				explicit JpegImage(const std::string& filename);
+
+ 				JpegImage(JpegImage&& image);
+ 				JpegImage& operator=(JpegImage&& image);
+ 				~JpegImage();
+
+ 				long cols() const;  // Returns the number of pixels in a row
+ 				long rows() const;  // Returns the number of rows
+
+ 				/** Returns the maximum size of the payload this image can hide, after the header and digest */
+ 				long max() const;
+
+ 				/**
+ 				 * Sets the options of 'steg()', the codec, cipher and digest being used as by 'MatImage'.
+ 				 * Throws 'Error' for more than 1 bit per coefficient or a scattered text.
+ 				 */
+ 				void set_options(const StegOptions& options);
+
+ 				/** Returns the sizes and times of the last 'steg()' */
+ 				const StegReport& report() const;
+
+ 				/**
+ 				 * Hides the bytes in the coefficients, like 'MatImage::steg()'. Throws 'InsufficientImageError' before
+ 				 * changing anything if they don't fit.
+ 				 */
+ 				JpegImage& steg(const uint8_t* data, std::size_t size, const KeySchedule& ks);
+
+ 				/** Whether a text is hidden in the image with this key, reading only the first coefficients */
+ 				bool is_stego(const KeySchedule& ks) const;
+
+ 				/** Returns the text hidden, throws like 'MatImage::unsteg()' */
+ 				std::string unsteg(const KeySchedule& ks) const;
+
+ 				/** Returns the digest of the header and the payload as stored, see 'MatImage::fingerprint()' */
+ 				Digest fingerprint(const KeySchedule& ks) const;
+
+ 				/**
+ 				 * Writes the coefficients to a JPEG file, with the quantization tables and the markers (e.g. EXIF,
+ 				 * ICC profile) of the image and optimized Huffman tables. Throws 'IOError' if it can't be written.
+ 				 */
+ 				void save(const std::string& filename) const;
+ 		};	// class 'JpegImage' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'JPEGIMAGE_H' closed.
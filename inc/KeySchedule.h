@@ -0,0 +1,98 @@
+/**
+ * This file declares 'KeySchedule' class that precomputes, once per key, the color to ignore and the bit plane
+ * used for every bit of a hidden byte.
+ * The key is consumed as 1 'ignore' character followed by 8 'store' characters per byte, wrapping around at its end,
+ * so the choices repeat after 'lcm(key length, 9)' characters i.e. 'period()' bytes.
+ * For the vector kernels the choices for the text are also expanded to one bit mask and one plane mask per sample.
+ */
+
+ #ifndef KEYSCHEDULE_H
+ #define KEYSCHEDULE_H
+
+ #include <string>
+ #include <vector>
+ #include <cstdint>
+ #include <cstddef>
+ #include "bitplane.h"
+ #include "util.h"
+ #include "Hash.h"
+
+ namespace Steganography
+ {
+ 	class KeySchedule
+ 		{
+ 			public :
+ 				/** What the key chooses for one byte hidden in 3 pixels (i.e. 9 colors) */
+ 				struct Entry
+ 					{
+ 						uint8_t ignore;		// The color (0 to 8) not used while hiding the text
+ 						uint8_t hignore;	// The color (0 to 7) not used while hiding the key hash
+ 						uint8_t planes;		// Bit 'b' of it is the plane (0 or 1) that stores bit 'b' of the byte
+ 					};
+
+ 			private :
+ 				/** The key itself */
+ 				std::string mKey;
+ 				
+ 				/** SHA-1 digest of the key, the one hidden in the first row */
+ 				Digest mDigest;
+
+ 				/** Choices for one full period of the key */
+ 				std::vector<Entry> mTable;
+ 				
+ 				/** Per sample masks of the text choices, for one period followed by 'SPAN' more bytes, in each order */
+ 				std::vector<uint8_t> mBits[2];
+ 				std::vector<uint8_t> mPlanes[2];
+
+ 			public :
+ 				/** Number of bytes after the end of the period also covered by 'bits()' and 'planes()' */
+ 				static const std::size_t SPAN = 32;
+ 				
+ 				/** Builds the schedule of the given key, throws 'KeyEmptyError' if it is empty */
+ 				KeySchedule(const std::string& key);
+
+ 				/** Returns the key the schedule is built from */
+ 				const std::string& key() const;
+ 				
+ 				/** Returns the SHA-1 digest of the key (20 bytes), computed once */
+ 				const Digest& digest() const;
+ 				
+ 				/** Returns the digest of the key with the given algorithm, from the cache of the process */
+ 				Digest digest(hashing::Algorithm a) const;
+
+ 				/** Returns the number of bytes after which the choices repeat */
+ 				std::size_t period() const;
+
+ 				/** Returns the choices for the byte at position 'n' of the period, 'n' must be less than 'period()' */
+ 				const Entry& operator[](std::size_t n) const
+ 					{
+ 						return mTable[n];
+ 					}
+
+ 				/**
+ 				 * Returns the masks of the 9 samples of the byte at position 'n' of the period, followed by those of the
+ 				 * next bytes (up to 'SPAN' bytes further, without wrapping around).
+ 				 * For a sample, 'bits' has the bit of the byte it stores set and 'planes' has the plane used set, both
+ 				 * are 0 for the ignored color. The samples are in the given channel order.
+ 				 */
+ 				const uint8_t* bits(std::size_t n, ChannelOrder order = RGB) const
+ 					{
+ 						return mBits[order].data() + 9*n;
+ 					}
+ 					
+ 				const uint8_t* planes(std::size_t n, ChannelOrder order = RGB) const
+ 					{
+ 						return mPlanes[order].data() + 9*n;
+ 					}
+ 					
+ 				/** Returns the position in the period of the n-th hidden byte (counted from the start of a region) */
+ 				std::size_t phase(std::size_t n) const
+ 					{
+ 						return n % mTable.size();
+ 					}
+
+ 		};	// class 'KeySchedule' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'KEYSCHEDULE_H' closed.
@@ -1,42 +1,146 @@
 /**
   * This file contains declaration of 'MatImage' class i.e. used to represent an image.
   * 'MatImage' class provides the basic methods to manipulate image for hiding the text inside them.
+  * It only depends on OpenCV's core and image codecs, see 'PixbufImage.h' for displaying it with GTK.
   */
  
  #ifndef MATIMAGE_H
  #define MATIMAGE_H
  
  #include <string>
- #include <gtkmm.h>
+ #include <iostream>
+ #include <memory>
+ #include <vector>
+ #include <utility>
  #include <opencv2/core/core.hpp>
- #include <opencv2/highgui/highgui.hpp>
- #include <opencv2/imgproc/imgproc.hpp>
+ #include "KeySchedule.h"
+ #include "Header.h"
+ #include "RowReader.h"
+ #include "RowWriter.h"
+ #include "ImageMap.h"
+ #include "Compression.h"
+ #include "Cipher.h"
  
  namespace Steganography
  {
+ 	/** What the last 'steg()' of an image did */
+ 	struct StegReport
+ 		{
+ 			uint64_t raw;			// Size (in bytes) of the text
+ 			uint64_t stored;		// Size (in bytes) of the payload hidden, once compressed and encrypted
+ 			double compress;		// Time (in seconds) taken to compress it
+ 			double embed;			// Time (in seconds) taken to hide it
+ 		};
+ 		
+ 	/** How 'steg()' hides the text, see the setters of 'MatImage' */
+ 	struct StegOptions
+ 		{
+ 			unsigned depth = 1;											// Bits of the payload per sample
+ 			bool scatter = false;										// Whether the payload is spread over the image
+ 			compression::Codec codec = compression::NONE;				// Codec the text is compressed with
+ 			int level = 0;												// Its level, 0 for its default one
+ 			crypto::Algorithm cipher = crypto::NONE;					// Algorithm the payload is encrypted with
+ 			uint32_t iterations = crypto::Envelope::ITERATIONS;		// Iterations of the key derivation
+ 			hashing::Algorithm digest = hashing::SHA1;					// Digest of the key in the first row
+ 		};
+ 		
  	/**
  	 * Class to represent an image & hide the text within it.
  	 */
  	  
  	class MatImage
  		{
- 			private : 
+ 			protected : 
  				/** The OpenCV's image class to hold our data */
  				cv::Mat mMat;
  				
+ 				/** The order of the channels of 'mMat', BGR as OpenCV decodes or RGB as GTK needs */
+ 				ChannelOrder mOrder = RGB;
+ 				
+ 				/** The decoder of the rows not decoded yet, for an image opened with 'stream()' */
+ 				std::shared_ptr<RowReader> mReader;
+ 				
+ 				/** The file mapped, for an image opened with 'map()', 'mMat' is a view of its pixels */
+ 				std::shared_ptr<ImageMap> mMap;
+ 				
+ 				/** Decodes the rows of an image opened with 'stream()' up to row 'rows' (excluded), if not done yet */
+ 				void decode(long rows) const;
+ 				
+ 				/** Create a view of the pixels of a mapped file */
+ 				explicit MatImage(const std::shared_ptr<ImageMap>& map);
+ 				
+ 			private : 
+ 				/** The ranges of pixels (counted row by row) modified by hiding text, for 'update()' */
+ 				std::vector<std::pair<long, long> > mTouched;
+ 				
+ 				/** How 'steg()' hides the text, see the setters */
+ 				StegOptions mOptions;
+ 				
+ 				/** What the last 'steg()' did */
+ 				StegReport mReport = StegReport();
+ 				
  				/** Helpers */
  				
+ 				/** Adds the pixels from 'first' to 'last' (excluded) to the ones modified */
+ 				void touch(long first, long last);
+ 				
  				/** Set the key view, the text hidden in the image */
- 				void set_key(const std::string& key);
+ 				void set_key(const KeySchedule& ks);
+ 				
+ 				/**
+ 				 * Hides 'count' bytes in the groups of 3 pixels from the second row onwards, starting at group 'first',
+ 				 * in the planes chosen by the key shifted by 'shift'
+ 				 */
+ 				void embed(const uint8_t* bytes, size_t count, size_t first, const KeySchedule& ks, unsigned shift = 0);
+ 				
+ 				/** Reads 'count' bytes hidden by 'embed()' */
+ 				void extract(uint8_t* bytes, size_t count, size_t first, const KeySchedule& ks, unsigned shift = 0) const;
  				
- 				/** Conceals the given 'text' in the image */
- 				void conceal(const std::string& text,const std::string& key);
+ 				/** Hides 'size' bytes of the payload from byte 'offset' of it, laid out as told by the header 'h' */
+ 				void put(const uint8_t* data, size_t size, uint64_t offset, const Header& h, const KeySchedule& ks);
  				
- 				/** Return  the SHA-1 hashed string of key set for image */
- 				std::string hash(const std::string& key) const;
+ 				/** Reads 'size' bytes of the payload hidden by 'put()' */
+ 				void get(uint8_t* data, size_t size, uint64_t offset, const Header& h, const KeySchedule& ks) const;
  				
- 				/** Returns the text hidden in the image */
- 				std::string reveal(const std::string& key) const;
+ 				/** Same as 'put()' and 'get()' for a payload spread over the image, with 'bits' bits per sample */
+ 				void scatter(const uint8_t* data, size_t size, uint64_t offset, unsigned bits, const KeySchedule& ks);
+ 				void gather(uint8_t* data, size_t size, uint64_t offset, unsigned bits, const KeySchedule& ks) const;
+ 				
+ 				/** Whether the key finds a text in the image, see 'header()' */
+ 				bool keyed(const KeySchedule& ks) const;
+ 				
+ 				/** Throws if the image is empty or too small to hold a text */
+ 				void verify() const;
+ 				
+ 				/** Throws if a payload of 'size' bytes (plus 'overhead' bytes) can't be hidden in the image */
+ 				void check(size_t size, size_t overhead = 0) const;
+ 				
+ 				/** Conceals the given bytes in the image, after a 'Header' (marked compressed with 'compressed') */
+ 				void conceal(const uint8_t* data, size_t size, bool compressed, const KeySchedule& ks);
+ 				
+ 				/** Encrypts the given bytes and hides them after their 'crypto::Envelope', as told by the header 'h' */
+ 				void seal(const uint8_t* data, size_t size, const Header& h, const KeySchedule& ks);
+ 				
+ 				/** Reads and decrypts the payload hidden by 'seal()', throws 'Error' if it was modified */
+ 				std::string unseal(const Header& h, const KeySchedule& ks) const;
+
+ 				
+ 				/**
+ 				 * Reads the 'Header', returns false for an image of the older format. The key is checked on the way: a
+ 				 * text in clear has the digest of the key in the first row, with the algorithm recorded in the header
+ 				 * (SHA-1 without one), and an encrypted one a header readable only with the key derived from the
+ 				 * password. Throws 'KeyMismatchError' if the key finds neither.
+ 				 */
+ 				bool header(Header& h, const KeySchedule& ks) const;
+ 				
+ 				/** Return  the SHA-1 digest of key set for image */
+ 				Digest hash(const KeySchedule& ks) const;
+ 				
+ 				/** Returns the text hidden in the image after the header 'h' */
+ 				std::string reveal(const Header& h, const KeySchedule& ks) const;
+ 				
+ 				/** Returns the text hidden in an image of the older format i.e. with no header and followed by '\0' */
+ 				std::string reveal_legacy(const KeySchedule& ks) const;
  				
  			public : 
  				/** Create an empty image with nothing */
@@ -45,14 +149,40 @@
  				/** Create an object of 'MatImage' class from image file name */
  				MatImage(const std::string& filename);
  				
- 				/** Create an object of 'MatImage' class from 'Pixbuf' object */
- 				MatImage(const Glib::RefPtr<Gdk::Pixbuf>& p);
+ 				/**
+ 				 * Opens an image file decoding its rows only when they are needed, e.g. to unsteg a short text from a
+ 				 * large image. A wrong password is then detected after the first row, and the rows after the text
+ 				 * are never decoded. Anything else than unsteg decodes the whole image first.
+ 				 * Files that 'map()' can map are mapped, PNG and PPM files are decoded row by row, other files are
+ 				 * decoded completely as above.
+ 				 */
+ 				static MatImage stream(const std::string& filename);
  				
- 				/** Create an object of 'MatImage' class from 'Mat' object */
- 				MatImage(const cv::Mat& mat);
+ 				/**
+ 				 * Opens an image file by mapping it in memory, so its pixels are used where they are with no decoding.
+ 				 * With 'ImageMap::SHARED' hiding text modifies the file itself, 'save()' to it then only flushes it.
+ 				 * Only PPM, PAM and top-down BMP files are mapped (see 'ImageMap.h'), other files are decoded as above.
+ 				 */
+ 				static MatImage map(const std::string& filename, ImageMap::Mode mode = ImageMap::PRIVATE);
+ 				
+  				/**
+  				 * Create a view of a 'Mat' object, with its channels in the given order.
+  				 * The pixels are NOT copied: hiding text modifies 'mat' itself, so it is not taken as const. Use
+  				 * 'clone()' for a copy. Throws 'Error' if 'mat' is not an 8-bit image with 3 channels.
+  				 */
+ 				explicit MatImage(cv::Mat& mat, ChannelOrder order = RGB);
  				
- 				/** Copies an object of 'MatImage' class to another object */
- 				MatImage(const MatImage& image);
+ 				/**
+ 				 * Create a view of a pixel buffer owned by the caller, 'rows' rows of 'cols' pixels of 3 bytes each,
+ 				 * starting every 'step' bytes. The buffer must outlive the object and its moves.
+ 				 */
+ 				MatImage(uint8_t* data, int cols, int rows, size_t step, ChannelOrder order = RGB);
+ 				
+ 				/** Images are moved, not copied implicitly, see 'clone()' */
+ 				MatImage(MatImage&& image) = default;
+ 				MatImage& operator=(MatImage&& image) = default;
+ 				MatImage(const MatImage& image) = delete;
+ 				MatImage& operator=(const MatImage& image) = delete;
  				
  				/** Destructor for class 'MatImage' */
  				virtual ~MatImage();
@@ -64,9 +194,33 @@
  				 * would only have been deleted, leaving the derived instance to cause a memory leak. 
  				 */
  				 
+ 				 /** Returns a deep copy of the image, owning its pixels, with the same steg options */
+ 				 MatImage clone() const;
+ 				 
  				 /** To save the image with the given filename */
  				 void save(const std::string& filename) const;
  				 
+ 				 /**
+ 				  * Same as above, a PNG file being encoded with the given settings (e.g. a faster preset, see
+ 				  * 'PngSettings') instead of OpenCV's. Throws 'IOError' if it can't be written.
+ 				  */
+ 				 void save(const std::string& filename, const PngSettings& png) const;
+ 				 
+ 				 /**
+ 				  * Saves the image to the file it was opened from, writing only the pixels modified since, if the file
+ 				  * has fixed row offsets (PPM, PAM and uncompressed 24-bit BMP). Any other file (e.g. PNG) is encoded
+ 				  * again with 'save()'. The pixels of the file are the same as with 'save()' either way.
+ 				  * The file must not have been changed since the image was opened.
+ 				  */
+ 				 void update(const std::string& filename) const;
+ 				 
+ 				 /**
+ 				  * Converts the pixels in place to the given channel order, if they are not in it already.
+ 				  * Hiding and reading work in both orders and give the same stego-image, this is only needed to hand
+ 				  * the pixels to something expecting an order e.g. GTK.
+ 				  */
+ 				 void convert(ChannelOrder order);
+ 				 
  				 /** Getters */
  				 
  				 long cols() const;  // Returns the number of pixels in a row (i.e. width)
@@ -75,40 +229,67 @@
  				 short channels() const;  // Returns the number of bytes in a pixel
  				 short bps() const;  // Returns the number of bits per sample
  				 uint8_t * data() const;  // Returns the pointer to pixel array
+ 				 ChannelOrder order() const;  // Returns the order of the channels of the pixel array
  				 long max() const;  // Returns the maximum size of text that this image can hide
+ 				 long max(unsigned bits) const;  // Same with 'bits' bits per sample
+ 				 unsigned depth() const;  // Returns the number of bits hidden per sample
+ 				 bool scattered() const;  // Whether the text is spread over the image
  				 bool empty() const;  // Check whether the image is empty or not
  				 
  				 /**
- 				  * Converts the image to 'Gdk::Pixbuf' object
- 				  * This can also be used to display image in Gtk window
- 				  * @return 'Gdk::Pixbuf' object of image
- 				  **/
- 				 Glib::RefPtr<Gdk::Pixbuf> pixbuf() const;
+ 				  * Sets the number of bits of the text hidden per color sample by 'steg()', from 1 (the default) to 4.
+ 				  * With 'k' bits the image holds 'k' times more and each byte modifies 'k' times less pixels, the bits
+ 				  * are then in the planes 0 to k-1 or 1 to k chosen by the key. 'unsteg()' finds it in the image.
+ 				  * Throws 'Error' for another number.
+ 				  */
+ 				 void set_depth(unsigned bits);
  				 
  				 /**
- 				  * Scales the image to the desired size
- 				  * One parameter is set to 0, it is adjusted to keep aspect ratio
- 				  * @param width			The width of desired size
- 				  * @param height			The height of desired size
- 				  * 
- 				  * @return A scaled 'Gdk::Pixbuf' object
+ 				  * Spreads the text hidden by 'steg()' over the whole image instead of hiding it from the second row on.
+ 				  * Each byte goes to a group of 3 pixels given by a permutation seeded by the key (see 'Permutation.h'),
+ 				  * so the changes are not clustered and any byte is found without reading the others. Saving only the
+ 				  * pixels modified ('update()') then rewrites the whole image. 'unsteg()' finds it in the image.
  				  */
- 				 Glib::RefPtr<Gdk::Pixbuf> scale(int width, int height) const;
+ 				 void set_scatter(bool on = true);
  				 
  				 /**
- 				  * Scales the image to fit in the desired size
- 				  * @param width			The width of desired size
- 				  * @param height			The height of desired size
- 				  * 
- 				  * @return A scaled 'Gdk::Pixbuf' object that fits in the given size 
+ 				  * Compresses the text with the given codec before 'steg()' hides it, so that it takes less pixels (and
+ 				  * time) when it is redundant e.g. logs or JSON. The codec is recorded with the payload and 'unsteg()'
+ 				  * decompresses it. A stream is then read completely before being compressed. A text that does not get
+ 				  * smaller, or any text with 'NONE' (the default), is hidden as it is.
+ 				  * @param		The codec
+ 				  * @param		Its level, 0 for its default one (see 'compression::compress()')
  				  */
- 				 Glib::RefPtr<Gdk::Pixbuf> fit(int width, int height) const;
+ 				 void set_compression(compression::Codec codec, int level = 0);
  				 
  				 /**
- 				  * Displays the image for certain amount of time
- 				  * @param msecs	Number of milliseconds to display
+ 				  * Encrypts the text (after compressing it) before 'steg()' hides it, with a key derived from the
+ 				  * password with a random salt. The password then protects the text itself and not only the places of
+ 				  * its bits, and any change to the hidden text is detected. 'unsteg()' decrypts it and throws 'Error' if
+ 				  * it was modified. The first row then holds a random salt and not the digest of the password, and the
+ 				  * header is masked with a key derived from the password and the salt ('crypto::mask()'), since either
+ 				  * would let a password be guessed at one hash per try: a wrong one is only told once a key is derived.
+ 				  * So is any wrong key given to 'unsteg()' or 'is_stego()', as the image may hold an encrypted text.
+ 				  * 'crypto::NONE' (the default) hides the text as it is.
+ 				  * @param		The algorithm, see 'crypto::preferred()'
+ 				  * @param		The number of iterations of the key derivation (PBKDF2)
  				  */
- 				 void show(int msecs = 0) const;
+ 				 void set_encryption(crypto::Algorithm algorithm, uint32_t iterations = crypto::Envelope::ITERATIONS);
+ 				 
+ 				 /**
+ 				  * Sets the algorithm of the digest of the key that 'steg()' hides in the first row (SHA-1 by default,
+ 				  * the only one older versions read). It is recorded in the header, 'unsteg()' finds it there.
+ 				  */
+ 				 void set_digest(hashing::Algorithm algorithm);
+ 				 
+ 				 /** Returns the options of 'steg()' */
+ 				 const StegOptions& options() const;
+ 				 
+ 				 /** Sets all the options of 'steg()' at once, through the setters above (which may throw) */
+ 				 void set_options(const StegOptions& options);
+ 				 
+ 				 /** Returns the sizes and times of the last 'steg()' */
+ 				 const StegReport& report() const;
  				 
  				 /**
  				  * Hide the text inside the image
@@ -120,12 +301,80 @@
  				  */
  				  MatImage& steg(const std::string& text, const std::string& key);
  				  
+ 				  /** Same as above, with the key schedule built once by the caller (e.g. for many images) */
+ 				  MatImage& steg(const std::string& text, const KeySchedule& ks);
+ 				  
+ 				  /**
+ 				   * Hide any binary payload (e.g. an archive) inside the image, without copying it
+ 				   * @param		The bytes to be hidden
+ 				   * @param		The number of bytes
+ 				   * @param		The password reqired to get hidden payload after
+ 				   *
+ 				   * @return		The object of class 'MatImage' itself
+ 				   */
+ 				  MatImage& steg(const uint8_t* data, size_t size, const std::string& key);
+ 				  MatImage& steg(const uint8_t* data, size_t size, const KeySchedule& ks);
+ 				  
+ 				  /**
+ 				   * Hide everything read from the stream, block by block as it is read
+ 				   * If the size of the stream can't be known in advance and it does not fit, 'InsufficientImageError' is
+ 				   * thrown with the image partly modified.
+ 				   * @param		The stream to read the payload from (opened in binary mode)
+ 				   * @param		The password reqired to get hidden payload after
+ 				   *
+ 				   * @return		The object of class 'MatImage' itself
+ 				   */
+ 				  MatImage& steg(std::istream& in, const std::string& key);
+ 				  MatImage& steg(std::istream& in, const KeySchedule& ks);
+ 				  
+ 				  /**
+ 				   * Check whether a text is hidden in the image with this password, reading only the first rows.
+ 				   * The digests are compared in constant time, and a wrong password costs a key derivation (see
+ 				   * 'set_encryption()'). Unlike 'unsteg()' it does not throw for a wrong password or an image too
+ 				   * small, it returns false.
+ 				   * @param		The password to check
+ 				   */
+ 				  bool is_stego(const std::string& key) const;
+ 				  bool is_stego(const KeySchedule& ks) const;
+ 				  
  				  /**
  				   * Get the hidden text from the image
  				   * @param		The password required to get the hidden text
  				   * @return	The hidden text
  				   */
  				  std::string unsteg(const std::string& key) const;
+ 				  
+ 				  /** Same as above, with the key schedule built once by the caller (e.g. for many images) */
+ 				  std::string unsteg(const KeySchedule& ks) const;
+ 				  
+ 				  /**
+ 				   * Write the hidden payload to the stream, block by block
+ 				   * @param		The password required to get the hidden payload
+ 				   * @param		The stream to write the payload to (opened in binary mode)
+ 				   */
+ 				  void unsteg(const std::string& key, std::ostream& out) const;
+ 				  void unsteg(const KeySchedule& ks, std::ostream& out) const;
+ 				  
+ 				  /**
+ 				   * Get 'length' bytes of the hidden payload from byte 'offset' of it, reading only their pixels: their
+ 				   * place and their position in the key schedule are computed directly, whatever the layout. Throws
+ 				   * 'RangeError' before reading them if they are not all in the payload (its length is in the header,
+ 				   * an image of the older format is read up to the end of its text first).
+ 				   * @param		The password required to get the hidden payload
+ 				   * @param		The position of the first byte to get
+ 				   * @param		The number of bytes to get
+ 				   * @return	The bytes
+ 				   */
+ 				  std::string unsteg_range(const std::string& key, uint64_t offset, uint64_t length) const;
+ 				  std::string unsteg_range(const KeySchedule& ks, uint64_t offset, uint64_t length) const;
+
+ 				  /**
+ 				   * Returns the SHA-256 digest of the header and the payload hidden as they are stored (compressed,
+ 				   * encrypted), reading only their pixels and never decompressing or decrypting. Two images hold the
+ 				   * same bits exactly when they have the same one, e.g. an image and the stego-image saved from it once
+ 				   * decoded again ('steg --verify'). Throws like 'unsteg()' if no text is hidden with the key.
+ 				   */
+ 				  Digest fingerprint(const KeySchedule& ks) const;
  		};	// class 'MatImage' closed.
  		
  }	// namespace 'Steganography' closed.
@@ -0,0 +1,54 @@
+/**
+ * This file declares 'Permutation' class, a key-seeded permutation of the integers below a given size that maps any
+ * of them in constant (expected) time, without building a table.
+ * It is a balanced Feistel network on the smallest even number of bits covering the size, and values that fall
+ * outside the range are encrypted again ("cycle walking") until they fall inside: the network has less than 4 times
+ * more values than the range, so it takes less than 4 rounds of the network on average.
+ * It spreads the payload over the whole image (see 'MatImage::set_scatter()'), it is NOT meant for cryptography.
+ */
+
+ #ifndef PERMUTATION_H
+ #define PERMUTATION_H
+
+ #include <string>
+ #include <cstdint>
+
+ namespace Steganography
+ {
+ 	class Permutation
+ 		{
+ 			public :
+ 				/** Number of rounds of the Feistel network */
+ 				static const int ROUNDS = 4;
+
+ 			private :
+ 				uint64_t mSize;
+
+ 				/** Number of bits of each half, and the mask of a half */
+ 				unsigned mHalf;
+ 				uint64_t mMask;
+
+ 				/** The keys of the rounds, derived from the key (and not from the digest hidden in the image) */
+ 				uint64_t mKeys[ROUNDS];
+
+ 				/** One pass of the network over the '2*mHalf' bits */
+ 				uint64_t encrypt(uint64_t x) const;
+ 				uint64_t decrypt(uint64_t x) const;
+
+ 			public :
+ 				/** Builds the permutation of [0, size) given by the key */
+ 				Permutation(const std::string& key, uint64_t size);
+
+ 				/** Returns the size of the range */
+ 				uint64_t size() const;
+
+ 				/** Returns the image of 'i', 'i' must be less than 'size()' */
+ 				uint64_t operator()(uint64_t i) const;
+
+ 				/** Returns the value whose image is 'i', 'i' must be less than 'size()' */
+ 				uint64_t inverse(uint64_t i) const;
+ 		};	// class 'Permutation' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'PERMUTATION_H' closed.
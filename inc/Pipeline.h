@@ -0,0 +1,75 @@
+/**
+ * This file declares 'Pipeline' class that hides a text while the image streams through memory band by band.
+ * A decoder thread decodes bands of rows ('RowReader'), the calling thread hides in each band the groups of 3 pixels
+ * lying in it, and an encoder thread encodes the bands to PNG ('RowWriter') as they are done. The stages are connected
+ * by bounded queues and the bands are recycled from a small pool, so decoding, hiding and encoding overlap and only
+ * 'BANDS' bands are in memory whatever the size of the image. The stego-image is the same as with 'MatImage'.
+ * The payload is packed (compressed, encrypted) before the first band, since the header precedes it.
+ */
+
+ #ifndef PIPELINE_H
+ #define PIPELINE_H
+
+ #include <string>
+ #include <memory>
+ #include <cstdint>
+ #include <cstddef>
+ #include "MatImage.h"
+ #include "RowReader.h"
+ #include "RowWriter.h"
+ #include "KeySchedule.h"
+
+ namespace Steganography
+ {
+ 	class Pipeline
+ 		{
+ 			private :
+ 				/** The decoder of the image */
+ 				std::shared_ptr<RowReader> mReader;
+
+ 				/** The stego-image to write */
+ 				std::string mFilename;
+
+ 				/** How the stego-image is encoded */
+ 				PngSettings mPng;
+
+ 				/** The digest of the header and the payload hidden by 'run()', see 'MatImage::fingerprint()' */
+ 				Digest mFingerprint = Digest();
+
+ 				Pipeline(const std::shared_ptr<RowReader>& reader, const std::string& filename, const PngSettings& png);
+
+ 			public :
+ 				/** Number of rows in a band */
+ 				static const int BAND = 32;
+
+ 				/** Number of bands in memory, at least 3: one being decoded, two being hidden in, one being encoded */
+ 				static const std::size_t BANDS = 4;
+
+ 				/**
+ 				 * Opens the image for hiding a text in it, saved as the given stego-image
+ 				 * @return	The pipeline, or null if it can't be streamed: the image can't be decoded row by row (see
+ 				 *			'RowReader'), the stego-image can't be encoded row by row (see 'RowWriter') or it is the
+ 				 *			image itself
+ 				 */
+ 				static std::shared_ptr<Pipeline> open(const std::string& image, const std::string& stego,
+ 													  const PngSettings& png = PngSettings());
+
+ 				/**
+ 				 * Hides the bytes with the options, like 'MatImage::steg()', and writes the stego-image. The image can
+ 				 * be run once only. Throws 'Error' for 'scatter', a scattered text needs the whole image.
+ 				 * Throws like 'MatImage::steg()' before the stego-image is created; if something fails afterwards
+ 				 * the stego-image is removed.
+ 				 * @return	The sizes and times, 'embed' being the time to decode, hide and encode
+ 				 */
+ 				StegReport run(const uint8_t* data, std::size_t size, const KeySchedule& ks, const StegOptions& options);
+
+ 				/**
+ 				 * Returns the digest of what 'run()' hid, the same as 'MatImage::fingerprint()' of the stego-image once
+ 				 * decoded if its format kept every bit
+ 				 */
+ 				const Digest& fingerprint() const;
+ 		};	// class 'Pipeline' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'PIPELINE_H' closed.
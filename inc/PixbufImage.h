@@ -0,0 +1,79 @@
+/**
+  * This file contains declaration of 'PixbufImage' class, a 'MatImage' that can be converted to and from a
+  * 'Gdk::Pixbuf' and displayed.
+  * It is the only part depending on gtkmm (and OpenCV's GUI), it is built separately from the core library so that
+  * the command line tools do not load GTK at all.
+  */
+ 
+ #ifndef PIXBUFIMAGE_H
+ #define PIXBUFIMAGE_H
+ 
+ #include <string>
+ #include <gtkmm.h>
+ #include "MatImage.h"
+ 
+ namespace Steganography
+ {
+ 	/**
+ 	 * Class to represent an image that can be displayed with GTK.
+ 	 */
+ 	 
+ 	class PixbufImage : public MatImage
+ 		{
+ 			private : 
+ 				/** The 'Gdk::Pixbuf' that owns the pixels, if created from one */
+ 				Glib::RefPtr<Gdk::Pixbuf> mPixbuf;
+ 				
+ 			public : 
+ 				/** Create an empty image with nothing */
+ 				PixbufImage() = default;
+ 				
+ 				/** Create an object of 'PixbufImage' class from image file name */
+ 				PixbufImage(const std::string& filename);
+ 				
+ 				/** Create an object of 'PixbufImage' class from 'Pixbuf' object */
+ 				PixbufImage(const Glib::RefPtr<Gdk::Pixbuf>& p);
+ 				
+ 				/** Create an object of 'PixbufImage' class taking the pixels of a 'MatImage', use 'clone()' to keep it */
+ 				explicit PixbufImage(MatImage&& image);
+ 				
+ 				/** Destructor for class 'PixbufImage' */
+ 				virtual ~PixbufImage();
+ 				
+ 				 /**
+ 				  * Converts the image to 'Gdk::Pixbuf' object
+ 				  * This can also be used to display image in Gtk window
+ 				  * The pixels are shared if they are in RGB, an image still in BGR as loaded is converted to new pixels
+ 				  * @return 'Gdk::Pixbuf' object of image
+ 				  **/
+ 				 Glib::RefPtr<Gdk::Pixbuf> pixbuf() const;
+ 				 
+ 				 /**
+ 				  * Scales the image to the desired size
+ 				  * One parameter is set to 0, it is adjusted to keep aspect ratio
+ 				  * @param width			The width of desired size
+ 				  * @param height			The height of desired size
+ 				  * 
+ 				  * @return A scaled 'Gdk::Pixbuf' object
+ 				  */
+ 				 Glib::RefPtr<Gdk::Pixbuf> scale(int width, int height) const;
+ 				 
+ 				 /**
+ 				  * Scales the image to fit in the desired size
+ 				  * @param width			The width of desired size
+ 				  * @param height			The height of desired size
+ 				  * 
+ 				  * @return A scaled 'Gdk::Pixbuf' object that fits in the given size 
+ 				  */
+ 				 Glib::RefPtr<Gdk::Pixbuf> fit(int width, int height) const;
+ 				 
+ 				 /**
+ 				  * Displays the image for certain amount of time
+ 				  * @param msecs	Number of milliseconds to display
+ 				  */
+ 				 void show(int msecs = 0) const;
+ 		};	// class 'PixbufImage' closed.
+ 		
+ }	// namespace 'Steganography' closed.
+ 
+ #endif	// 'PIXBUFIMAGE_H' closed.
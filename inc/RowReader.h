@@ -0,0 +1,75 @@
+/**
+ * This file declares 'RowReader' class that decodes an image file row by row, on demand.
+ * Reading a short text only needs the first rows of a stego-image, so 'MatImage::stream()' decodes the rows as the
+ * key digest, the header and the text are read and never decodes the rest. PNG (non-interlaced) and binary PPM are
+ * read this way, other files are decoded completely by OpenCV.
+ */
+
+ #ifndef ROWREADER_H
+ #define ROWREADER_H
+
+ #include <string>
+ #include <memory>
+ #include <mutex>
+ #include <cstdint>
+ #include <cstddef>
+ #include "bitplane.h"
+
+ namespace Steganography
+ {
+ 	class RowReader
+ 		{
+ 			private :
+ 				/** Number of rows decoded so far */
+ 				int mDone;
+
+ 				/** 'decode()' may be called by several threads */
+ 				std::mutex mMutex;
+
+ 			protected :
+ 				int mCols;
+ 				int mRows;
+ 				ChannelOrder mOrder;
+
+ 				RowReader();
+
+ 				/** Decodes the next row, 'mCols' pixels of 3 bytes, throws 'IOError' if the file is corrupted */
+ 				virtual void read(uint8_t* row) = 0;
+
+ 				/** Releases the file once every row is decoded */
+ 				virtual void close() = 0;
+
+ 			public :
+ 				virtual ~RowReader();
+
+ 				/**
+ 				 * Opens an image file and reads its header
+ 				 * @return	The reader, or null if the format can't be decoded row by row
+ 				 */
+ 				static std::shared_ptr<RowReader> open(const std::string& filename);
+
+ 				int cols() const;  // Returns the number of pixels in a row
+ 				int rows() const;  // Returns the number of rows
+ 				ChannelOrder order() const;  // Returns the order of the channels of the decoded rows
+
+ 				/**
+ 				 * Decodes the rows not decoded yet up to row 'count' (excluded)
+ 				 * @param	data	The first row of the image to decode to
+ 				 * @param	step	The number of bytes between 2 rows of 'data'
+ 				 * @param	count	The number of rows needed from the top
+ 				 */
+ 				void decode(uint8_t* data, size_t step, long count);
+
+ 				/**
+ 				 * Decodes the next rows (after the ones already decoded) to a buffer of its own, e.g. band by band
+ 				 * @param	data	Where to decode the first of them
+ 				 * @param	step	The number of bytes between 2 rows of 'data'
+ 				 * @param	count	The number of rows wanted
+ 				 * @return			The number of rows decoded, less than 'count' at the end of the image
+ 				 */
+ 				int next(uint8_t* data, size_t step, int count);
+ 		};	// class 'RowReader' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'ROWREADER_H' closed.
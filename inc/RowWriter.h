@@ -0,0 +1,104 @@
+/**
+ * This file declares 'RowWriter' class that encodes an image file row by row, as the rows come.
+ * It is the counterpart of 'RowReader': 'Pipeline' encodes the rows of a stego-image while the next ones are still
+ * being decoded and hidden in, so the whole image is never in memory. Only PNG is written this way, by default with the
+ * settings OpenCV uses so that the files are alike, see 'PngSettings' for faster ones.
+ */
+
+ #ifndef ROWWRITER_H
+ #define ROWWRITER_H
+
+ #include <string>
+ #include <memory>
+ #include <cstdint>
+ #include <cstddef>
+ #include "bitplane.h"
+
+ namespace Steganography
+ {
+ 	/**
+ 	 * How a PNG file is encoded. The defaults are OpenCV's (the stego-images of 'MatImage::save()'), see 'preset()'
+ 	 * for faster or smaller ones. With more than 1 thread the rows are deflated in blocks of about 128 KiB in
+ 	 * parallel, each block primed with the 32 KiB before it (as 'pigz' does), so the file is a bit larger than with 1.
+ 	 */
+ 	struct PngSettings
+ 		{
+ 			/** The filters of the rows, 'ADAPTIVE' choosing the best one for each row */
+ 			enum Filter { NONE, SUB, UP, AVERAGE, PAETH, ADAPTIVE };
+ 			
+ 			/** The zlib strategies, of the same values as zlib's */
+ 			enum Strategy { DEFAULT_STRATEGY = 0, FILTERED = 1, HUFFMAN_ONLY = 2, RLE = 3 };
+ 			
+ 			int level = 1;					// zlib level, from 0 (stored) to 9
+ 			Filter filter = SUB;
+ 			Strategy strategy = RLE;
+ 			unsigned threads = 1;			// Threads deflating the rows, 0 for one per core
+ 			
+ 			/**
+ 			 * Returns the settings of a preset, all of them but "default" on every core:
+ 			 *	"default"	OpenCV's, the Sub filter and zlib's RLE strategy at level 1
+ 			 *	"fastest"	the rows stored as they are (level 0), as large as a PPM file
+ 			 *	"fast"		the Up filter, about 20% faster than "default" and 6% larger on photos
+ 			 *	"small"		the Paeth filter, about 40% slower than "default" and 4% smaller on photos
+ 			 * Higher levels and other strategies were measured too, they are much slower for 1% less at most.
+ 			 * Throws 'Error' for another name. See 'README.md' for the times and sizes.
+ 			 */
+ 			static PngSettings preset(const std::string& name);
+ 			
+ 			/** Returns the filter of the given name ("none", "sub", "up", "average", "paeth" or "adaptive") */
+ 			static Filter filter_of(const std::string& name);
+ 		};
+ 		
+ 	class RowWriter
+ 		{
+ 			private :
+ 				/** Number of rows encoded so far */
+ 				int mDone;
+
+ 			protected :
+ 				int mCols;
+ 				int mRows;
+ 				ChannelOrder mOrder;
+
+ 				RowWriter(int cols, int rows, ChannelOrder order);
+
+ 				/** Encodes the next row, 'mCols' pixels of 3 bytes, throws 'IOError' if the file can't be written */
+ 				virtual void write(const uint8_t* row) = 0;
+
+ 				/** Ends the file once every row is encoded, throws 'IOError' if it can't be written */
+ 				virtual void finish() = 0;
+
+ 			public :
+ 				virtual ~RowWriter();
+
+ 				/** Returns whether a file of the given name can be encoded row by row (by its extension) */
+ 				static bool supported(const std::string& filename);
+
+ 				/**
+ 				 * Creates an image file and writes its header
+ 				 * @param	filename	The file, replaced if it exists
+ 				 * @param	cols		The number of pixels in a row
+ 				 * @param	rows		The number of rows
+ 				 * @param	order		The order of the channels of the rows to encode
+ 				 * @param	png			How a PNG file is encoded
+ 				 * @return	The writer, or null if the format can't be encoded row by row
+ 				 * Throws 'IOError' if the file can't be created.
+ 				 */
+ 				static std::shared_ptr<RowWriter> open(const std::string& filename, int cols, int rows,
+ 													   ChannelOrder order = RGB, const PngSettings& png = PngSettings());
+
+ 				int cols() const;  // Returns the number of pixels in a row
+ 				int rows() const;  // Returns the number of rows
+
+ 				/**
+ 				 * Encodes the next rows, the file is complete once the last row is encoded
+ 				 * @param	data	The first of them
+ 				 * @param	step	The number of bytes between 2 rows of 'data'
+ 				 * @param	count	The number of rows, more than the rows left are ignored
+ 				 */
+ 				void encode(const uint8_t* data, size_t step, int count);
+ 		};	// class 'RowWriter' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'ROWWRITER_H' closed.
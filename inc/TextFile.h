@@ -33,7 +33,7 @@
  				 */
  				 
  				
- 				/** Open a text file and return the object of class 'TextFile' */
+ 				/** Open a text (or any binary) file with a single read and return the object of class 'TextFile' */
  				static TextFile open(const std::string& filename);
  				
  				/** Returns the size (in bytes) of the text file */
@@ -66,7 +66,7 @@
  				TextFile& append(const TextFile& textFile);
  				TextFile& operator +=(const TextFile& textFile);
  				
- 				/** Saves the text file to the disk with the given filename */
+ 				/** Saves the text file to the disk with the given filename, with a single write */
  				void save(const std::string& filename);
  				
  		};	// class 'TextFile' closed.
@@ -0,0 +1,101 @@
+/**
+ * This file defines the bit-plane kernels used by the embedding loops of 'MatImage'.
+ * They are header-only so that they get inlined, and they do NOT check their arguments: the callers validate once
+ * at the API boundary ('MatImage::steg()', 'MatImage::unsteg()' and 'KeySchedule') and not once per bit.
+ * For checked versions see 'setbit()' and 'getbit()' in 'util.h'.
+ *
+ * The samples of a group are numbered in RGB order (R, G, B of the 1st pixel, then of the 2nd, ...), as they always
+ * were. Images kept in BGR order (as OpenCV decodes them) use the same numbering mapped with 'bgr()', so stego-images
+ * are the same whatever the order in memory.
+ */
+
+ #ifndef BITPLANE_H
+ #define BITPLANE_H
+
+ #include <cstdint>
+
+ namespace Steganography
+ {
+ 	/** Order of the channels of the pixels in memory */
+ 	enum ChannelOrder { RGB, BGR };
+ 	
+ 	namespace bitplane
+ 	{
+ 		/** Returns the position in memory of the sample 'i' (in RGB order) of a group stored in BGR order */
+ 		constexpr unsigned bgr(unsigned i)
+ 			{
+ 				return i + 2 - 2*(i % 3);
+ 			}
+ 			
+ 		/** Returns the position in memory of the sample 'i' (in RGB order) of a group stored in order 'O' */
+ 		template<ChannelOrder O>
+ 		constexpr unsigned at(unsigned i)
+ 			{
+ 				return (O == BGR) ? bgr(i) : i;
+ 			}
+ 			
+ 		/** Returns the sample with the bit at 'plane' (0 to 7) replaced by 'bit' (0 or 1) */
+ 		constexpr uint8_t embed(uint8_t sample, unsigned bit, unsigned plane)
+ 			{
+ 				return static_cast<uint8_t>( (sample & ~(1u << plane)) | (bit << plane) );
+ 			}
+
+ 		/** Returns the bit (0 or 1) at 'plane' (0 to 7) of the sample */
+ 		constexpr unsigned extract(uint8_t sample, unsigned plane)
+ 			{
+ 				return (sample >> plane) & 1u;
+ 			}
+
+ 		/**
+ 		 * Hides the 8 bits of 'byte' in 9 consecutive samples (3 pixels), skipping the sample 'ignore'.
+ 		 * Bit 'b' goes to the b-th used sample, in the plane given by bit 'b' of 'planes' plus 'shift'.
+ 		 * There is no branch: the ignored sample is rewritten with an empty mask.
+ 		 * @tparam	O			The order of the channels in memory
+ 		 * @param	s			The 9 samples
+ 		 * @param	byte		The byte to hide
+ 		 * @param	ignore		The sample (0 to 8) to leave unchanged
+ 		 * @param	planes		The store planes (0 or 1) of the 8 bits
+ 		 * @param	shift		Added to the planes, to hide more bytes in the same samples (0 to 3)
+ 		 */
+ 		template<ChannelOrder O = RGB>
+ 		inline void scatter(uint8_t* s, uint8_t byte, unsigned ignore, unsigned planes, unsigned shift = 0)
+ 			{
+ 				for(unsigned i = 0; i < 9; ++i)
+ 					{
+ 						unsigned used = (i != ignore);			// 0 only for the ignored sample
+ 						unsigned b = i - (i > ignore);			// Bit of the byte that goes to this sample
+ 						unsigned plane = ((planes >> b) & 1u) + shift;
+ 						unsigned mask = used << plane;
+ 						uint8_t& x = s[at<O>(i)];
+ 						x = static_cast<uint8_t>( (x & ~mask) | ((((byte >> b) & 1u) << plane) & mask) );
+ 					}
+ 			}
+
+ 		/**
+ 		 * Reads back the byte hidden by 'scatter()'
+ 		 * @tparam	O			The order of the channels in memory
+ 		 * @param	s			The 9 samples
+ 		 * @param	ignore		The sample (0 to 8) not used
+ 		 * @param	planes		The store planes (0 or 1) of the 8 bits
+ 		 * @param	shift		Added to the planes
+ 		 * @return				The hidden byte
+ 		 */
+ 		template<ChannelOrder O = RGB>
+ 		inline uint8_t gather(const uint8_t* s, unsigned ignore, unsigned planes, unsigned shift = 0)
+ 			{
+ 				unsigned byte = 0;
+ 				for(unsigned i = 0; i < 9; ++i)
+ 					{
+ 						unsigned used = (i != ignore);
+ 						unsigned b = i - (i > ignore);
+ 						unsigned plane = ((planes >> b) & 1u) + shift;
+ 						byte |= ((s[at<O>(i)] >> plane) & used) << b;
+ 					}
+ 				return static_cast<uint8_t>(byte);
+ 			}
+
+ 	}	// namespace 'bitplane' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'BITPLANE_H' closed.
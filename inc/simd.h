@@ -0,0 +1,61 @@
+/**
+ * This file declares the kernels that hide and read a run of bytes in contiguous groups of 3 pixels (9 samples).
+ * They use SSE4.1 or AVX2 when the processor supports them (checked once at run time), the scalar kernels of
+ * 'bitplane.h' otherwise. All of them give bit-identical results.
+ */
+
+ #ifndef SIMD_H
+ #define SIMD_H
+
+ #include <string>
+ #include <cstdint>
+ #include <cstddef>
+ #include "KeySchedule.h"
+
+ namespace Steganography
+ {
+ 	namespace simd
+ 	{
+ 		/** The instruction sets used by the kernels */
+ 		enum Level { SCALAR, SSE41, AVX2 };
+
+ 		/** Returns the instruction set in use, the best one supported by default */
+ 		Level level();
+
+ 		/** Uses the given instruction set, or the best supported one below it. Returns the one in use. */
+ 		Level use(Level l);
+
+ 		/** Returns the name of an instruction set e.g. to report it */
+ 		std::string name(Level l);
+
+ 		/**
+ 		 * Hides 'count' bytes in the 'count' groups of 9 samples starting at 's'
+ 		 * @param	s			The samples
+ 		 * @param	bytes		The bytes to hide
+ 		 * @param	count		The number of bytes
+ 		 * @param	ks			The key schedule
+ 		 * @param	k			The position in the period of 'ks' of the first byte
+ 		 * @param	order		The order of the channels in memory
+ 		 * @param	shift		Added to the planes chosen by the key (0 to 3), see 'bitplane::scatter()'
+ 		 */
+ 		void embed(uint8_t* s, const uint8_t* bytes, std::size_t count, const KeySchedule& ks, std::size_t k,
+ 				   ChannelOrder order = RGB, unsigned shift = 0);
+
+ 		/**
+ 		 * Reads 'count' bytes hidden in the 'count' groups of 9 samples starting at 's'
+ 		 * @param	s			The samples
+ 		 * @param	bytes		Where to store the bytes read
+ 		 * @param	count		The number of bytes
+ 		 * @param	ks			The key schedule
+ 		 * @param	k			The position in the period of 'ks' of the first byte
+ 		 * @param	order		The order of the channels in memory
+ 		 * @param	shift		Added to the planes chosen by the key (0 to 3)
+ 		 */
+ 		void extract(const uint8_t* s, uint8_t* bytes, std::size_t count, const KeySchedule& ks, std::size_t k,
+ 					 ChannelOrder order = RGB, unsigned shift = 0);
+
+ 	}	// namespace 'simd' closed.
+
+ }	// namespace 'Steganography' closed.
+
+ #endif	// 'SIMD_H' closed.
@@ -6,9 +6,13 @@
  #define UTIL_H
  
  #include <string>
+ #include <array>
  
  namespace Steganography
  {
+ 	/** A SHA-1 digest, kept on the stack */
+ 	using Digest = std::array<unsigned char, 20>;
+ 	
  	/** Function that return SHA-1 string of given string.
  	  * The return string is of 20 bytes always.
  	  * @param		in		The string to be hashed
@@ -16,6 +20,17 @@
  	  */
  	std::string sha(const std::string& in);
  	
+ 	/** Same as above, without allocating a string.
+ 	  * @param		in		The string to be hashed
+ 	  * @return				The SHA-1 digest of 'in'
+ 	  */
+ 	Digest sha1(const std::string& in);
+ 	
+ 	/** Compares two digests in a time that does not depend on where they differ.
+ 	  * @return				Whether they are equal
+ 	  */
+ 	bool same(const Digest& a, const Digest& b);
+ 	
  	/** Sets a bit.
  	  *
  	  * @param		p		A byte whose bits needs to be changed/ set.
@@ -0,0 +1,439 @@
+/**
+ * This file contains the definitions of 'Batch' class
+ * Declaration is in 'Batch.h'
+ */
+
+#include <fstream>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Batch.h"
+#include "BoundedQueue.h"
+#include "MatImage.h"
+#include "JpegImage.h"
+#include "Formats.h"
+#include "Capacity.h"
+#include "Error.h"
+
+using namespace std;
+
+using Clock = chrono::steady_clock;
+
+namespace
+{
+	using namespace Steganography;
+
+	/** An image going through the pipeline */
+	struct Job
+		{
+			size_t index;
+			const BatchItem* item;
+			unique_ptr<MatImage> image;
+			unique_ptr<JpegImage> jpeg;	// Instead of 'image' for a JPEG image to unsteg
+			string error;				// Not empty once a stage failed, next stages skip the job
+			uint64_t bytes;
+			Clock::time_point start;
+		};
+
+	using JobPtr = unique_ptr<Job>;
+	using Stage = function<void(Job&)>;
+
+	/** Returns the size of an open file, leaving it at its beginning */
+	uint64_t file_size(ifstream& in)
+		{
+			in.seekg(0, ios::end);
+			streamoff size = in.tellg();
+			in.seekg(0, ios::beg);
+			return (size > 0) ? static_cast<uint64_t>(size) : 0;
+		}
+
+	/**
+	 * Identifies a file: by its device and inode if it exists, so that two names of the same file match, else by its
+	 * name with the directory resolved (an output not written yet)
+	 */
+	string identity(const string& filename)
+		{
+			struct stat st;
+			if(stat(filename.c_str(), &st) == 0)
+				return "i" + to_string(st.st_dev) + ":" + to_string(st.st_ino);
+
+			size_t slash = filename.rfind('/');
+			string dir = (slash == string::npos) ? "." : filename.substr(0, slash + 1);
+			string name = (slash == string::npos) ? filename : filename.substr(slash + 1);
+
+			char path[PATH_MAX];
+			if(realpath(dir.c_str(), path) == nullptr)
+				return "n" + filename;
+			return "n" + string(path) + "/" + name;
+		}
+
+	/**
+	 * Returns why the output of each item can't be written (empty if it can): it is the image or payload of an item,
+	 * itself included, or the output of another item, which would be written by two workers at once
+	 */
+	vector<string> clashes(const vector<BatchItem>& items)
+		{
+			vector<string> outputs(items.size());
+			map<string, string> inputs;
+			for(size_t i = 0; i < items.size(); ++i)
+				{
+					outputs[i] = identity(items[i].output);
+					inputs.insert(make_pair(identity(items[i].image), items[i].image));
+					if(not items[i].payload.empty())
+						inputs.insert(make_pair(identity(items[i].payload), items[i].payload));
+				}
+
+			vector<string> reasons(items.size());
+			for(size_t i = 0; i < items.size(); ++i)
+				{
+					map<string, string>::const_iterator input = inputs.find(outputs[i]);
+					if(input != inputs.end())
+						reasons[i] = " Error ! The output '" + items[i].output + "' would overwrite the input '"
+									 + input->second + "' .... ";
+					else if(count(outputs.begin(), outputs.end(), outputs[i]) > 1)
+						reasons[i] = " Error ! The output '" + items[i].output + "' is the output of another image too .... ";
+				}
+			return reasons;
+		}
+
+	/** Whether the file name has the extension of an image format OpenCV reads */
+	bool is_image(string name)
+		{
+			static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".bmp", ".ppm", ".pgm", ".pnm", ".tif",
+												".tiff", ".webp", ".jp2", ".sr", ".ras" };
+
+			transform(name.begin(), name.end(), name.begin(), ::tolower);
+			for(const char* e : extensions)
+				{
+					string ext(e);
+					if(name.size() > ext.size() and name.compare(name.size() - ext.size(), ext.size(), ext) == 0)
+						return true;
+				}
+			return false;
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Create a batch
+	Batch::Batch(Mode mode, unsigned workers) : mMode(mode), mWorkers(workers)
+		{
+			if(mWorkers == 0)
+				mWorkers = max(1u, thread::hardware_concurrency());
+
+			mQueue = 2 * mWorkers;
+		}
+
+	// Check the stego-images once saved
+	void Batch::set_verify(bool on)
+		{
+			mVerify = on;
+		}
+
+	// Options of every 'steg()'
+	void Batch::set_options(const StegOptions& options)
+		{
+			mOptions = options;
+		}
+
+	// Cached key schedules
+	shared_ptr<const KeySchedule> Batch::schedule(const string& key)
+		{
+			lock_guard<mutex> lock(mSchedulesMutex);
+
+			shared_ptr<const KeySchedule>& ks = mSchedules[key];
+			if(not ks)
+				ks = make_shared<KeySchedule>(key);
+			return ks;
+		}
+
+	// Read a manifest
+	vector<BatchItem> Batch::manifest(const string& filename, Mode mode)
+		{
+			ifstream file(filename.c_str());
+			if(not file)
+				throw IOError(" Error ! Can't open the manifest '" + filename + "' .... ");
+
+			vector<BatchItem> items;
+			string line;
+			size_t fields = (mode == STEG) ? 4 : 3;
+
+			for(size_t number = 1; getline(file, line); ++number)
+				{
+					if(not line.empty() and line.back() == '\r')
+						line.pop_back();
+
+					if(line.empty() or line[0] == '#')
+						continue;
+
+					vector<string> f;
+					stringstream ss(line);
+					for(string field; getline(ss, field, '\t'); )
+						f.push_back(field);
+
+					if(f.size() != fields)
+						throw IOError(" Error ! Line " + to_string(number) + " of the manifest should have "
+										+ to_string(fields) + " tab-separated fields .... ");
+
+					BatchItem item;
+					item.image = f[0];
+					if(mode == STEG)
+						{
+							item.payload = f[1];
+							item.key = f[2];
+							item.output = f[3];
+						}
+					else
+						{
+							item.key = f[1];
+							item.output = f[2];
+						}
+					items.push_back(item);
+				}
+
+			return items;
+		}
+
+	// List the images of a directory
+	vector<BatchItem> Batch::directory(const string& dir, const string& payload, const string& key,
+										const string& outdir, Mode mode)
+		{
+			DIR* d = opendir(dir.c_str());
+			if(not d)
+				throw IOError(" Error ! Can't open the directory '" + dir + "' .... ");
+
+			vector<string> names;
+			while(dirent* entry = readdir(d))
+				{
+					string name = entry->d_name;
+					struct stat st;
+					if(is_image(name) and stat((dir + "/" + name).c_str(), &st) == 0 and S_ISREG(st.st_mode))
+						names.push_back(name);
+				}
+			closedir(d);
+
+			sort(names.begin(), names.end());
+
+			vector<BatchItem> items;
+			for(const string& name : names)
+				{
+					BatchItem item;
+					item.image = dir + "/" + name;
+					item.payload = payload;
+					item.key = key;
+					item.output = outdir + "/" + name.substr(0, name.rfind('.')) + (mode == STEG ? ".png" : ".txt");
+					items.push_back(item);
+				}
+
+			return items;
+		}
+
+	// Run the pipeline
+	BatchSummary Batch::run(const vector<BatchItem>& items, ostream& report)
+		{
+			BatchSummary summary = { 0, 0, 0, 0.0 };
+			mutex reportMutex;
+			Clock::time_point start = Clock::now();
+
+			// An output that would overwrite an input, or another output, fails its item before anything is done
+			const vector<string> refused = clashes(items);
+
+			// The stages, the first one always decodes the image
+			vector<Stage> stages;
+
+			stages.push_back([this, &refused](Job& job)
+				{
+					if(not refused[job.index].empty())
+						throw IOError(refused[job.index]);
+
+					// Uncompressed files are mapped, to unsteg only the rows up to the end of the text are decoded
+					if(mMode == STEG)
+						{
+							// A lossy output would lose the text, so it fails before anything is decoded
+							formats::check(job.item->output);
+
+							// So does an image too small for the payload, found out from its header (the size of a compressed
+							// payload is only known once it is compressed, 'steg()' checks it then)
+							struct stat st;
+							capacity::Carrier c = capacity::probe(job.item->image);
+							if(mOptions.codec == compression::NONE and stat(job.item->payload.c_str(), &st) == 0
+							   and static_cast<uint64_t>(st.st_size) > capacity::capacity(c, mOptions))
+								throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+
+							job.image.reset(new MatImage(MatImage::map(job.item->image)));
+							job.image->set_options(mOptions);
+						}
+					else if(JpegImage::supported(job.item->image))
+						job.jpeg.reset(new JpegImage(job.item->image));	// The text is in its DCT coefficients
+					else
+						job.image.reset(new MatImage(MatImage::stream(job.item->image)));
+				});
+
+			if(mMode == STEG)
+				{
+					stages.push_back([this](Job& job)
+						{
+							ifstream payload(job.item->payload.c_str(), ios::binary);
+							if(not payload)
+								throw IOError(" Error ! Can't open the payload '" + job.item->payload + "' .... ");
+
+							job.bytes = file_size(payload);
+							job.image->steg(payload, *schedule(job.item->key));
+						});
+
+					stages.push_back([this](Job& job)
+						{
+							job.image->save(job.item->output);
+
+							if(mVerify)
+								{
+									shared_ptr<const KeySchedule> ks = schedule(job.item->key);
+									if(MatImage::stream(job.item->output).fingerprint(*ks) != job.image->fingerprint(*ks))
+										throw Error(" The stego-image '" + job.item->output + "' does not hold the text ! ");
+								}
+
+							job.image.reset();
+						});
+				}
+			else
+				{
+					stages.push_back([this](Job& job)
+						{
+							ofstream out(job.item->output.c_str(), ios::binary);
+							if(not out)
+								throw IOError(" Error ! Can't open the output '" + job.item->output + "' .... ");
+
+							try
+								{
+									if(job.jpeg)
+										{
+											// The text is read from the coefficients as a whole
+											string text = job.jpeg->unsteg(*schedule(job.item->key));
+											if(not out.write(text.data(), text.size()))
+												throw IOError(" Error ! Can't write the hidden text .... ");
+										}
+									else
+										job.image->unsteg(*schedule(job.item->key), out);
+								}
+							catch(...)
+								{
+									// Don't leave an empty or partial output behind
+									out.close();
+									remove(job.item->output.c_str());
+									throw;
+								}
+
+							job.bytes = static_cast<uint64_t>(out.tellp());
+							job.image.reset();
+							job.jpeg.reset();
+						});
+				}
+
+			// Report a finished job
+			auto finish = [&](Job& job)
+				{
+					double seconds = chrono::duration<double>(Clock::now() - job.start).count();
+
+					lock_guard<mutex> lock(reportMutex);
+					report << "[" << setw(to_string(items.size()).size()) << job.index + 1 << "/" << items.size() << "] ";
+
+					if(job.error.empty())
+						{
+							++summary.done;
+							summary.bytes += job.bytes;
+							report << "OK    " << job.item->image << " -> " << job.item->output
+									<< " (" << job.bytes << " bytes, " << fixed << setprecision(3) << seconds << " s)";
+						}
+					else
+						{
+							++summary.failed;
+							report << "FAIL  " << job.item->image << " :" << job.error;
+						}
+					report << endl;
+				};
+
+			// Queues between the stages, the first stage takes the items in order
+			vector<unique_ptr<BoundedQueue<JobPtr> > > queues;
+			for(size_t s = 1; s < stages.size(); ++s)
+				queues.emplace_back(new BoundedQueue<JobPtr>(mQueue));
+
+			atomic<size_t> next(0);
+			vector<unique_ptr<atomic<unsigned> > > running;
+			for(size_t s = 0; s < stages.size(); ++s)
+				running.emplace_back(new atomic<unsigned>(mWorkers));
+
+			auto worker = [&](size_t s)
+				{
+					for( ; ; )
+						{
+							JobPtr job;
+
+							if(s == 0)
+								{
+									size_t i = next++;
+									if(i >= items.size())
+										break;
+
+									job.reset(new Job());
+									job->index = i;
+									job->item = &items[i];
+									job->bytes = 0;
+									job->start = Clock::now();
+								}
+							else if(not queues[s-1]->pop(job))
+								break;
+
+							if(job->error.empty())
+								{
+									try
+										{
+											stages[s](*job);
+										}
+									catch(const exception& e)
+										{
+											job->error = e.what();
+											job->image.reset();
+											job->jpeg.reset();
+										}
+								}
+
+							if(s + 1 < stages.size())
+								queues[s]->push(std::move(job));
+							else
+								finish(*job);
+						}
+
+					// The last worker of a stage tells the next stage that nothing more will come
+					if(--*running[s] == 0 and s + 1 < stages.size())
+						queues[s]->close();
+				};
+
+			vector<thread> threads;
+			for(size_t s = 0; s < stages.size(); ++s)
+				for(unsigned w = 0; w < mWorkers; ++w)
+					threads.emplace_back(worker, s);
+
+			for(thread& t : threads)
+				t.join();
+
+			summary.seconds = chrono::duration<double>(Clock::now() - start).count();
+
+			report << ":: " << summary.done << " done, " << summary.failed << " failed, "
+					<< fixed << setprecision(3) << summary.seconds << " s, "
+					<< setprecision(1) << (summary.done + summary.failed) / summary.seconds << " images/s, "
+					<< setprecision(2) << summary.bytes / summary.seconds / 1e6 << " MB/s of payload" << endl;
+
+			return summary;
+		}
+
+} // namespace 'Steganography' closed.
@@ -0,0 +1,339 @@
+/**
+ * This file contains the definitions of the capacity planner
+ * Declaration is in 'Capacity.h'
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include "Capacity.h"
+#include "JpegImage.h"
+#include "Header.h"
+#include "Compression.h"
+#include "Cipher.h"
+#include "Error.h"
+
+using namespace std;
+
+using byte = uint8_t;
+
+namespace
+{
+	using namespace Steganography;
+	using capacity::Carrier;
+
+	// Big-endian and little-endian integers
+	unsigned be16(const byte* p) { return (p[0] << 8) | p[1]; }
+	unsigned long be32(const byte* p) { return (static_cast<unsigned long>(be16(p)) << 16) | be16(p + 2); }
+	unsigned le16(const byte* p) { return p[0] | (p[1] << 8); }
+	long le32(const byte* p) { return static_cast<int32_t>(le16(p) | (static_cast<uint32_t>(le16(p + 2)) << 16)); }
+
+	/** PNG : the IHDR chunk always comes first */
+	bool png(FILE* f, Carrier& c)
+		{
+			static const byte SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+			static const int CHANNELS[7] = { 1, 0, 3, 1, 2, 0, 4 };	// By color type
+
+			byte h[26];
+			if(fread(h, 1, sizeof(h), f) != sizeof(h) or memcmp(h, SIGNATURE, 8) != 0 or memcmp(h + 12, "IHDR", 4) != 0)
+				return false;
+
+			c.cols = static_cast<long>(be32(h + 16));
+			c.rows = static_cast<long>(be32(h + 20));
+			c.bps = h[24];
+			c.channels = (h[25] < 7) ? CHANNELS[h[25]] : 0;
+			return c.channels > 0;
+		}
+
+	/** JPEG : the markers are skipped up to the first start of frame (SOF0 to SOF15, but DHT, JPG and DAC) */
+	bool jpeg(FILE* f, Carrier& c)
+		{
+			byte m[4];
+			if(fread(m, 1, 2, f) != 2 or m[0] != 0xFF or m[1] != 0xD8)
+				return false;
+
+			while(fread(m, 1, 4, f) == 4 and m[0] == 0xFF)
+				{
+					unsigned marker = m[1], length = be16(m + 2);
+					if(length < 2)
+						return false;
+
+					if(marker >= 0xC0 and marker <= 0xCF and marker != 0xC4 and marker != 0xC8 and marker != 0xCC)
+						{
+							byte sof[6];
+							if(fread(sof, 1, 6, f) != 6)
+								return false;
+
+							c.bps = sof[0];
+							c.rows = static_cast<long>(be16(sof + 1));
+							c.cols = static_cast<long>(be16(sof + 3));
+							c.channels = sof[5];
+							c.coefficients = true;
+							return true;
+						}
+
+					if(fseek(f, static_cast<long>(length) - 2, SEEK_CUR) != 0)
+						return false;
+				}
+
+			return false;
+		}
+
+	// Next token of a PNM header, comments skipped
+	bool token(FILE* f, string& t)
+		{
+			int ch = fgetc(f);
+			while(ch != EOF and (isspace(ch) or ch == '#'))
+				{
+					if(ch == '#')
+						while(ch != EOF and ch != '\n')
+							ch = fgetc(f);
+					ch = fgetc(f);
+				}
+
+			t.clear();
+			while(ch != EOF and not isspace(ch) and t.size() < 32)
+				{
+					t += static_cast<char>(ch);
+					ch = fgetc(f);
+				}
+
+			return not t.empty();
+		}
+
+	/** PNM : "P1" to "P6" then the width, height and maximum value, or "P7" then "<TOKEN> <value>" lines */
+	bool pnm(FILE* f, Carrier& c)
+		{
+			string t;
+			if(not token(f, t) or t.size() != 2 or t[0] != 'P' or t[1] < '1' or t[1] > '7')
+				return false;
+
+			char kind = t[1];
+			long maxval = 1;
+
+			if(kind == '7')
+				{
+					for(string v; token(f, t) and t != "ENDHDR"; )
+						{
+							if(not token(f, v))
+								return false;
+
+							if(t == "WIDTH")
+								c.cols = atol(v.c_str());
+							else if(t == "HEIGHT")
+								c.rows = atol(v.c_str());
+							else if(t == "DEPTH")
+								c.channels = atoi(v.c_str());
+							else if(t == "MAXVAL")
+								maxval = atol(v.c_str());
+						}
+				}
+			else
+				{
+					if(not token(f, t))
+						return false;
+					c.cols = atol(t.c_str());
+
+					if(not token(f, t))
+						return false;
+					c.rows = atol(t.c_str());
+
+					if(kind != '1' and kind != '4')
+						{
+							if(not token(f, t))
+								return false;
+							maxval = atol(t.c_str());
+						}
+
+					c.channels = (kind == '3' or kind == '6') ? 3 : 1;
+				}
+
+			c.bps = (maxval > 255) ? 16 : (maxval > 1) ? 8 : 1;
+			return c.cols > 0 and c.rows > 0 and c.channels > 0;
+		}
+
+	/** BMP : the file header then the info header, a negative height meaning the rows are stored top-down */
+	bool bmp(FILE* f, Carrier& c)
+		{
+			byte h[30];
+			if(fread(h, 1, sizeof(h), f) != sizeof(h) or h[0] != 'B' or h[1] != 'M')
+				return false;
+
+			// The old OS/2 header has 16-bit sizes
+			if(le32(h + 14) == 12)
+				{
+					c.cols = le16(h + 18);
+					c.rows = le16(h + 20);
+					c.bps = le16(h + 24);
+				}
+			else
+				{
+					c.cols = le32(h + 18);
+					c.rows = std::abs(le32(h + 22));
+					c.bps = le16(h + 28);
+				}
+
+			// 24 and 32 bits are 3 and 4 samples of 8 bits, 16 bits are 3 samples of 5 bits, less is an index in a palette
+			c.channels = (c.bps >= 24) ? c.bps / 8 : (c.bps == 16) ? 3 : 1;
+			c.bps = (c.bps == 16) ? 5 : c.bps;
+			c.bps = (c.bps >= 24) ? 8 : c.bps;
+			return c.cols > 0 and c.rows > 0;
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	namespace capacity
+	{
+		// Read the header of an image
+		Carrier probe(const string& filename, bool coefficients)
+			{
+				Carrier c;
+				c.filename = filename;
+
+				FILE* f = fopen(filename.c_str(), "rb");
+				if(not f)
+					throw IOError(" Error ! Can't open the image file '" + filename + "' .... ");
+
+				// The format is told by the first bytes, whatever the extension
+				bool (*readers[])(FILE*, Carrier&) = { png, jpeg, pnm, bmp };
+				bool known = false;
+				for(auto reader : readers)
+					{
+						Carrier tried = c;
+						rewind(f);
+						if(reader(f, tried))
+							{
+								c = tried;
+								known = true;
+								break;
+							}
+					}
+				fclose(f);
+
+				// The coefficients are read once here, not every time the capacity is asked for
+				if(known and coefficients and c.coefficients)
+					c.dct = JpegImage(filename).max();
+
+				if(known)
+					return c;
+
+				// Any other format is decoded, as 'steg' would
+				MatImage image(filename);
+				c.cols = image.cols();
+				c.rows = image.rows();
+				c.channels = image.channels();
+				c.bps = image.bps();
+				c.decoded = true;
+				return c;
+			}
+
+		// Probe many images
+		vector<Carrier> probe(const vector<string>& filenames, unsigned threads, bool coefficients)
+			{
+				vector<Carrier> carriers(filenames.size());
+				atomic<size_t> next(0);
+
+				auto work = [&]()
+					{
+						for(size_t i = next++; i < filenames.size(); i = next++)
+							{
+								try
+									{
+										carriers[i] = probe(filenames[i], coefficients);
+									}
+								catch(const exception& e)
+									{
+										carriers[i].filename = filenames[i];
+										carriers[i].error = e.what();
+									}
+							}
+					};
+
+				// One thread per core by default, as 'Batch'
+				if(threads == 0)
+					threads = max(1u, thread::hardware_concurrency());
+				threads = static_cast<unsigned>(std::min<size_t>(threads, filenames.size()));
+
+				vector<thread> pool;
+				for(unsigned t = 1; t < threads; ++t)
+					pool.emplace_back(work);
+				work();
+				for(thread& t : pool)
+					t.join();
+
+				return carriers;
+			}
+
+		// Largest payload as stored
+		uint64_t capacity(const Carrier& carrier, const StegOptions& options, bool coefficients)
+			{
+				uint64_t overhead = (options.cipher != crypto::NONE) ? crypto::Envelope::SIZE : 0;
+				uint64_t bytes = 0;
+
+				if(not carrier.error.empty())
+					return 0;
+
+				if(coefficients and carrier.coefficients)
+					{
+						if(carrier.dct < 0)
+							throw Error(" The coefficients of '" + carrier.filename + "' were not counted, see 'capacity::probe()' ! ");
+						bytes = static_cast<uint64_t>(carrier.dct);
+					}
+				else if(carrier.cols >= 80)
+					{
+						// As 'MatImage::max()'
+						long groups = (carrier.cols*(carrier.rows-1))/3 - static_cast<long>(Header::SIZE);
+						bytes = (groups > 0) ? static_cast<uint64_t>(groups) * options.depth : 0;
+					}
+
+				return (bytes > overhead) ? bytes - overhead : 0;
+			}
+
+		// Size once compressed
+		uint64_t packed(const byte* data, size_t size, const StegOptions& options)
+			{
+				if(options.codec == compression::NONE)
+					return size;
+
+				// A text that does not get smaller is hidden as it is
+				return std::min<uint64_t>(size, compression::compress(options.codec, options.level, data, size).size());
+			}
+
+		// Smallest carrier that fits
+		const Carrier* smallest(const vector<Carrier>& carriers, uint64_t stored, const StegOptions& options,
+								bool coefficients)
+			{
+				const Carrier* best = nullptr;
+				uint64_t least = 0;
+
+				for(const Carrier& c : carriers)
+					{
+						uint64_t bytes = capacity(c, options, coefficients);
+						if(bytes >= stored and (not best or bytes < least))
+							{
+								best = &c;
+								least = bytes;
+							}
+					}
+
+				return best;
+			}
+
+		// Pick from a pool
+		string pick(const vector<string>& pool, const byte* data, size_t size, const StegOptions& options,
+					unsigned threads)
+			{
+				vector<Carrier> carriers = probe(pool, threads);
+				const Carrier* c = smallest(carriers, packed(data, size, options), options);
+				return c ? c->filename : string();
+			}
+
+	}	// namespace 'capacity' closed.
+
+}	// namespace 'Steganography' closed.
@@ -0,0 +1,199 @@
+/**
+ * This file contains the definitions of the payload encryption
+ * Declaration is in 'Cipher.h'
+ */
+
+#include <climits>
+#include <algorithm>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include "Cipher.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	// The EVP cipher of an algorithm
+	const EVP_CIPHER* evp(Steganography::crypto::Algorithm a)
+		{
+			return (a == Steganography::crypto::AES_256_GCM) ? EVP_aes_256_gcm() : EVP_chacha20_poly1305();
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	namespace crypto
+	{
+		// Write the envelope
+		void Envelope::write(uint8_t* out) const
+			{
+				out[0] = static_cast<uint8_t>(algorithm);
+				out[1] = out[2] = out[3] = 0;
+
+				for(int i = 0; i < 4; ++i)
+					out[4 + i] = static_cast<uint8_t>(iterations >> (8*i));
+
+				std::copy(salt, salt + 16, out + 8);
+				std::copy(nonce, nonce + 12, out + 24);
+				std::copy(tag, tag + 16, out + 36);
+			}
+
+		// Read the envelope
+		void Envelope::read(const uint8_t* in)
+			{
+				if(in[0] == NONE or in[0] > CHACHA20_POLY1305)
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				algorithm = static_cast<Algorithm>(in[0]);
+
+				iterations = 0;
+				for(int i = 0; i < 4; ++i)
+					iterations |= static_cast<uint32_t>(in[4 + i]) << (8*i);
+
+				// A forged count must not make the KDF run for hours
+				if(iterations == 0 or iterations > MAX_ITERATIONS)
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				std::copy(in + 8, in + 24, salt);
+				std::copy(in + 24, in + 36, nonce);
+				std::copy(in + 36, in + 52, tag);
+			}
+
+		// Name of an algorithm
+		string name(Algorithm a)
+			{
+				static const char* names[] = { "none", "aes-256-gcm", "chacha20-poly1305" };
+				return names[a];
+			}
+
+		// Algorithm of a name
+		Algorithm algorithm(const string& name)
+			{
+				for(int a = NONE; a <= CHACHA20_POLY1305; ++a)
+					if(name == crypto::name(static_cast<Algorithm>(a)))
+						return static_cast<Algorithm>(a);
+
+				throw Error(" Unknown encryption '" + name + "' ! ");
+			}
+
+		// The algorithm the processor is best at
+		Algorithm preferred()
+			{
+			#if defined(__x86_64__) || defined(__i386__)
+				__builtin_cpu_init();
+				if(__builtin_cpu_supports("aes") and __builtin_cpu_supports("pclmul"))
+					return AES_256_GCM;
+				return CHACHA20_POLY1305;
+			#else
+				return AES_256_GCM;
+			#endif
+			}
+
+		// Random bytes
+		void random(uint8_t* out, size_t size)
+			{
+				if(RAND_bytes(out, static_cast<int>(size)) != 1)
+					throw Error(" Error ! Can't draw random bytes .... ");
+			}
+
+		// Mask a header
+		void mask(const string& password, const uint8_t* salt, uint8_t* header)
+			{
+				unsigned char key[Header::SIZE];
+				if(PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()), salt, 16,
+									 static_cast<int>(Envelope::ITERATIONS), EVP_sha256(), sizeof(key), key) != 1)
+					throw Error(" Error ! Can't derive the key of the header .... ");
+
+				for(size_t i = 0; i < Header::SIZE; ++i)
+					header[i] ^= key[i];
+
+				OPENSSL_cleanse(key, sizeof(key));
+			}
+
+		// Derive the key and start
+		Cipher::Cipher(Direction d, const string& password, Envelope& e, const Header& h) :
+			mDirection(d), mCtx(EVP_CIPHER_CTX_new())
+			{
+				if(not mCtx)
+					throw Error(" Error ! Can't start the encryption .... ");
+
+				if(d == ENCRYPT and (RAND_bytes(e.salt, sizeof(e.salt)) != 1 or RAND_bytes(e.nonce, sizeof(e.nonce)) != 1))
+					{
+						EVP_CIPHER_CTX_free(mCtx);
+						throw Error(" Error ! Can't draw a random salt .... ");
+					}
+
+				unsigned char key[32];
+				bool ok = PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()), e.salt, sizeof(e.salt),
+											static_cast<int>(e.iterations), EVP_sha256(), sizeof(key), key) == 1
+						and EVP_CipherInit_ex(mCtx, evp(e.algorithm), NULL, NULL, NULL, d == ENCRYPT) == 1
+						and EVP_CIPHER_CTX_ctrl(mCtx, EVP_CTRL_AEAD_SET_IVLEN, sizeof(e.nonce), NULL) == 1
+						and EVP_CipherInit_ex(mCtx, NULL, NULL, key, e.nonce, d == ENCRYPT) == 1;
+
+				OPENSSL_cleanse(key, sizeof(key));
+
+				// The associated data: the header but its length, then the algorithm and iterations of the envelope
+				uint8_t aad[Header::SIZE + 8], envelope[Envelope::SIZE];
+				Header a = h;
+				a.length = 0;
+				a.write(aad);
+				e.write(envelope);
+				std::copy(envelope, envelope + 8, aad + Header::SIZE);
+
+				int length = 0;
+				ok = ok and EVP_CipherUpdate(mCtx, NULL, &length, aad, sizeof(aad)) == 1;
+
+				if(not ok)
+					{
+						EVP_CIPHER_CTX_free(mCtx);
+						throw Error(" Error ! Can't start the encryption .... ");
+					}
+			}
+
+		// Destructor
+		Cipher::~Cipher()
+			{
+				EVP_CIPHER_CTX_free(mCtx);
+			}
+
+		// Encrypt or decrypt a chunk
+		void Cipher::update(const uint8_t* in, uint8_t* out, size_t size)
+			{
+				// EVP takes 'int' sizes
+				while(size > 0)
+					{
+						int count = static_cast<int>(std::min<size_t>(size, INT_MAX / 2)), length = 0;
+						if(EVP_CipherUpdate(mCtx, out, &length, in, count) != 1 or length != count)
+							throw Error(" Error ! Can't encrypt the text .... ");
+
+						in += count;
+						out += count;
+						size -= count;
+					}
+			}
+
+		// End the payload
+		void Cipher::finish(Envelope& e)
+			{
+				unsigned char rest[16];
+				int length = 0;
+
+				if(mDirection == ENCRYPT)
+					{
+						if(EVP_CipherFinal_ex(mCtx, rest, &length) != 1
+								or EVP_CIPHER_CTX_ctrl(mCtx, EVP_CTRL_AEAD_GET_TAG, sizeof(e.tag), e.tag) != 1)
+							throw Error(" Error ! Can't encrypt the text .... ");
+						return;
+					}
+
+				if(EVP_CIPHER_CTX_ctrl(mCtx, EVP_CTRL_AEAD_SET_TAG, sizeof(e.tag), e.tag) != 1
+						or EVP_CipherFinal_ex(mCtx, rest, &length) != 1)
+					throw Error(" Incorrect password, or the hidden text was modified ! ");
+			}
+
+	}	// namespace 'crypto' closed.
+
+}	// namespace 'Steganography' closed.
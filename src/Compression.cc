@@ -0,0 +1,266 @@
+/**
+ * This file contains the definitions of the payload codecs
+ * Declaration is in 'Compression.h'
+ */
+
+#include <zlib.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+#include "Compression.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	using namespace Steganography::compression;
+
+	/**
+	 * The most a byte of compressed data can decompress to: a deflate match of 258 bytes takes 2 bits at best, an LZ4
+	 * one adds 255 bytes per byte and a zstd RLE block of 128 KiB takes 4 bytes
+	 */
+	uint64_t ratio(Codec c)
+		{
+			switch(c)
+				{
+					case ZLIB :
+						return 1032;
+					case ZSTD :
+						return 32768;
+					case LZ4 :
+						return 255;
+					default :
+						return 1;
+				}
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	namespace compression
+	{
+		// Write the frame
+		void Frame::write(uint8_t* out) const
+			{
+				out[0] = static_cast<uint8_t>(codec);
+				out[1] = static_cast<uint8_t>(level);
+				out[2] = 0;
+				out[3] = 0;
+
+				for(int i = 0; i < 8; ++i)
+					out[4 + i] = static_cast<uint8_t>(raw >> (8*i));
+			}
+
+		// Read the frame
+		void Frame::read(const uint8_t* in)
+			{
+				if(in[0] == NONE or in[0] > LZ4)
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				codec = static_cast<Codec>(in[0]);
+				level = static_cast<int8_t>(in[1]);
+
+				if(not available(codec))
+					throw Error(" The text is compressed with " + name(codec) + ", which is not available ! ");
+
+				raw = 0;
+				for(int i = 0; i < 8; ++i)
+					raw |= static_cast<uint64_t>(in[4 + i]) << (8*i);
+			}
+
+		// Whether the codec was built in
+		bool available(Codec c)
+			{
+				switch(c)
+					{
+						case NONE :
+						case ZLIB :
+							return true;
+#ifdef HAVE_ZSTD
+						case ZSTD :
+							return true;
+#endif
+#ifdef HAVE_LZ4
+						case LZ4 :
+							return true;
+#endif
+						default :
+							return false;
+					}
+			}
+
+		// Name of a codec
+		string name(Codec c)
+			{
+				static const char* names[] = { "none", "zlib", "zstd", "lz4" };
+				return names[c];
+			}
+
+		// Codec of a name
+		Codec codec(const string& name)
+			{
+				for(int c = NONE; c <= LZ4; ++c)
+					if(name == compression::name(static_cast<Codec>(c)))
+						{
+							if(not available(static_cast<Codec>(c)))
+								throw Error(" The codec '" + name + "' is not available in this build ! ");
+							return static_cast<Codec>(c);
+						}
+
+				throw Error(" Unknown codec '" + name + "' ! ");
+			}
+
+		// Default level
+		int default_level(Codec c)
+			{
+				switch(c)
+					{
+						case ZLIB :
+							return 6;		// What 'Z_DEFAULT_COMPRESSION' means
+						case ZSTD :
+							return 3;
+						case LZ4 :
+							return 1;		// The acceleration, higher is faster
+						default :
+							return 0;
+					}
+			}
+
+		// Compress
+		vector<uint8_t> compress(Codec c, int level, const uint8_t* data, size_t size)
+			{
+				if(level == 0)
+					level = default_level(c);
+
+				if(size > Frame::MAX_RAW)
+					throw Error(" The text is too large to be compressed ! ");
+
+				Frame f;
+				f.codec = c;
+				f.level = static_cast<int8_t>(level);
+				f.raw = size;
+
+				vector<uint8_t> out;
+
+				switch(c)
+					{
+						case ZLIB :
+							{
+								if(level < 1 or level > 9)
+									throw Error(" The level of zlib should be from 1 to 9 ! ");
+
+								uLongf length = compressBound(size);
+								out.resize(Frame::SIZE + length);
+								if(compress2(out.data() + Frame::SIZE, &length, data, size, level) != Z_OK)
+									throw Error(" Error ! Can't compress the text .... ");
+								out.resize(Frame::SIZE + length);
+								break;
+							}
+#ifdef HAVE_ZSTD
+						case ZSTD :
+							{
+								if(level < ZSTD_minCLevel() or level > ZSTD_maxCLevel() or level < -128)
+									throw Error(" Unsupported level of zstd ! ");
+
+								out.resize(Frame::SIZE + ZSTD_compressBound(size));
+								size_t length = ZSTD_compress(out.data() + Frame::SIZE, out.size() - Frame::SIZE, data, size, level);
+								if(ZSTD_isError(length))
+									throw Error(" Error ! Can't compress the text .... ");
+								out.resize(Frame::SIZE + length);
+								break;
+							}
+#endif
+#ifdef HAVE_LZ4
+						case LZ4 :
+							{
+								if(level < 1 or level > 127)
+									throw Error(" The level (acceleration) of LZ4 should be from 1 to 127 ! ");
+								if(size > LZ4_MAX_INPUT_SIZE)
+									throw Error(" The text is too large for LZ4 ! ");
+
+								int bound = LZ4_compressBound(static_cast<int>(size));
+								out.resize(Frame::SIZE + bound);
+								int length = LZ4_compress_fast(reinterpret_cast<const char *>(data),
+															   reinterpret_cast<char *>(out.data() + Frame::SIZE),
+															   static_cast<int>(size), bound, level);
+								if(length <= 0)
+									throw Error(" Error ! Can't compress the text .... ");
+								out.resize(Frame::SIZE + length);
+								break;
+							}
+#endif
+						default :
+							throw Error(" The codec '" + name(c) + "' is not available in this build ! ");
+					}
+
+				f.write(out.data());
+				return out;
+			}
+
+		// Decompress
+		string decompress(const uint8_t* data, size_t size)
+			{
+				if(size < Frame::SIZE)
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				// An unknown or unavailable codec throws here, before anything is allocated
+				Frame f;
+				f.read(data);
+
+				data += Frame::SIZE;
+				size -= Frame::SIZE;
+
+				// A size the data can't decompress to was forged (or the image is corrupted)
+				if(f.raw > Frame::MAX_RAW or f.raw > static_cast<uint64_t>(size) * ratio(f.codec))
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				string out(static_cast<size_t>(f.raw), '\0');
+				bool ok = false;
+
+				switch(f.codec)
+					{
+						case ZLIB :
+							{
+								uLongf length = out.size();
+								ok = uncompress(reinterpret_cast<Bytef *>(&out[0]), &length, data, size) == Z_OK
+										and length == out.size();
+								break;
+							}
+#ifdef HAVE_ZSTD
+						case ZSTD :
+							{
+								size_t length = ZSTD_decompress(&out[0], out.size(), data, size);
+								ok = not ZSTD_isError(length) and length == out.size();
+								break;
+							}
+#endif
+#ifdef HAVE_LZ4
+						case LZ4 :
+							{
+								if(size > LZ4_MAX_INPUT_SIZE or out.size() > LZ4_MAX_INPUT_SIZE)
+									break;
+
+								int length = LZ4_decompress_safe(reinterpret_cast<const char *>(data), &out[0],
+																 static_cast<int>(size), static_cast<int>(out.size()));
+								ok = length >= 0 and static_cast<size_t>(length) == out.size();
+								break;
+							}
+#endif
+						default :
+							break;
+					}
+
+				if(not ok)
+					throw Error(" The image is not stego or it is corrupted ! ");
+
+				return out;
+			}
+
+	}	// namespace 'compression' closed.
+
+}	// namespace 'Steganography' closed.
@@ -24,6 +24,8 @@ namespace Steganography
 
 	KeyMismatchError::KeyMismatchError(const string& msg) : Error(msg) {}
 
+	RangeError::RangeError(const string& msg) : Error(msg) {}
+	
 	IOError::IOError(const string& msg) : Error(msg) {}
 
 	// Error with message
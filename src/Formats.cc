@@ -0,0 +1,103 @@
+/**
+ * This file contains the registry of the image formats
+ * Declaration is in 'Formats.h'
+ */
+
+#include <sstream>
+#include <algorithm>
+#include "Formats.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	using Steganography::formats::Format;
+
+	/** The formats OpenCV writes, and what they keep */
+	const Format FORMATS[] =
+		{
+			{ "PNG", "png", true, false, true, false, "" },
+			{ "PPM", "ppm pnm", true, true, false, false, "" },
+			{ "PAM", "pam", true, true, false, false, "" },
+			{ "BMP", "bmp dib", true, true, false, false, "" },
+			{ "TIFF", "tif tiff", true, false, false, false, "" },
+			{ "Sun raster", "sr ras", true, false, false, false, "" },
+			{ "JPEG", "jpg jpeg jpe", false, false, false, true, "its quantization rounds every sample" },
+			{ "WebP", "webp", false, false, false, false, "it is compressed with loss by default" },
+			{ "JPEG 2000", "jp2", false, false, false, false, "it may be compressed with loss" },
+			{ "PGM", "pgm", false, false, false, false, "it keeps a single gray channel" },
+			{ "PBM", "pbm", false, false, false, false, "it keeps a single bit per pixel" },
+			{ "OpenEXR", "exr", false, false, false, false, "its samples are floating point" },
+			{ "Radiance HDR", "hdr pic", false, false, false, false, "its samples share an exponent" }
+		};
+
+	// Lower case extension of a file name
+	string extension(const string& filename)
+		{
+			size_t dot = filename.rfind('.');
+			if(dot == string::npos or filename.find('/', dot) != string::npos)
+				return "";
+
+			string ext = filename.substr(dot + 1);
+			transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			return ext;
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	namespace formats
+	{
+		// Format of a file
+		const Format* find(const string& filename)
+			{
+				string ext = extension(filename);
+				if(ext.empty())
+					return nullptr;
+
+				for(const Format& f : FORMATS)
+					{
+						stringstream ss(f.extensions);
+						for(string e; ss >> e; )
+							if(e == ext)
+								return &f;
+					}
+
+				return nullptr;
+			}
+
+		// Whether the format keeps the pixels
+		bool lossless(const string& filename)
+			{
+				const Format* f = find(filename);
+				return f and f->lossless;
+			}
+
+		// Same name in PNG
+		string lossless_name(const string& filename)
+			{
+				size_t dot = filename.rfind('.');
+				if(dot == string::npos or filename.find('/', dot) != string::npos)
+					return filename + ".png";
+
+				return filename.substr(0, dot) + ".png";
+			}
+
+		// Check a stego-image name
+		void check(const string& filename)
+			{
+				const Format* f = find(filename);
+
+				if(not f)
+					throw Error(" Unknown image format of '" + filename + "', save it as '" + lossless_name(filename) + "' ! ");
+
+				if(not f->lossless)
+					throw Error(" Can't save the stego-image as " + string(f->name) + ": " + f->loss
+								+ ", which destroys the hidden text. Save it as '" + lossless_name(filename) + "' ! ");
+			}
+
+	}	// namespace 'formats' closed.
+
+}	// namespace 'Steganography' closed.
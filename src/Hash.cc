@@ -0,0 +1,168 @@
+/**
+ * This file contains the definitions of the digests of the keys
+ * Declaration is in 'Hash.h'
+ */
+
+#include <list>
+#include <mutex>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+#include <openssl/evp.h>
+#include "Hash.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	using namespace Steganography;
+
+	// The EVP digest of an algorithm, fetched once
+	const EVP_MD* md(hashing::Algorithm a)
+		{
+		#if OPENSSL_VERSION_NUMBER >= 0x30000000L
+			static EVP_MD* mds[] = { EVP_MD_fetch(NULL, "SHA1", NULL), EVP_MD_fetch(NULL, "SHA256", NULL),
+									 EVP_MD_fetch(NULL, "BLAKE2B-512", NULL) };
+			return mds[a];
+		#else
+			switch(a)
+				{
+					case hashing::SHA256 : return EVP_sha256();
+					case hashing::BLAKE2B : return EVP_blake2b512();
+					default : return EVP_sha1();
+				}
+		#endif
+		}
+
+	/** The digests of the passwords used last, the oldest one is dropped beyond 'CAPACITY' */
+	class Cache
+		{
+			private :
+				static const size_t CAPACITY = 64;
+
+				typedef pair<string, Digest> Item;		// The algorithm followed by the password, and the digest
+
+				list<Item> mItems;						// From the most recently used
+				unordered_map<string, list<Item>::iterator> mIndex;
+				mutex mMutex;
+
+			public :
+				Digest get(hashing::Algorithm a, const string& key)
+					{
+						string id = char('0' + a) + key;
+
+						{
+							lock_guard<mutex> lock(mMutex);
+							auto it = mIndex.find(id);
+							if(it != mIndex.end())
+								{
+									mItems.splice(mItems.begin(), mItems, it->second);
+									return it->second->second;
+								}
+						}
+
+						// Hashed without the lock, two threads may both hash a new key but get the same digest
+						Digest d = hashing::compute(a, key.data(), key.size());
+
+						lock_guard<mutex> lock(mMutex);
+						if(mIndex.count(id) == 0)
+							{
+								mItems.emplace_front(id, d);
+								mIndex[id] = mItems.begin();
+
+								if(mItems.size() > CAPACITY)
+									{
+										mIndex.erase(mItems.back().first);
+										mItems.pop_back();
+									}
+							}
+
+						return d;
+					}
+		};
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	namespace hashing
+	{
+		// Name of an algorithm
+		string name(Algorithm a)
+			{
+				static const char* names[] = { "sha1", "sha256", "blake2b" };
+				return names[a];
+			}
+
+		// Algorithm of a name
+		Algorithm algorithm(const string& name)
+			{
+				for(int a = SHA1; a <= BLAKE2B; ++a)
+					if(name == hashing::name(static_cast<Algorithm>(a)))
+						return static_cast<Algorithm>(a);
+
+				throw Error(" Unknown digest '" + name + "' ! ");
+			}
+
+		// Constructor
+		Context::Context() : mCtx(EVP_MD_CTX_new())
+			{
+				if(not mCtx)
+					throw Error(" Error ! Can't start the digest .... ");
+			}
+
+		// Destructor
+		Context::~Context()
+			{
+				EVP_MD_CTX_free(mCtx);
+			}
+
+		// Start a digest
+		void Context::start(Algorithm a)
+			{
+				if(EVP_DigestInit_ex(mCtx, md(a), NULL) != 1)
+					throw Error(" Error ! Can't start the digest .... ");
+			}
+
+		// Hash the next bytes
+		void Context::update(const void* data, size_t size)
+			{
+				if(EVP_DigestUpdate(mCtx, data, size) != 1)
+					throw Error(" Error ! Can't compute the digest .... ");
+			}
+
+		// End the digest
+		Digest Context::finish()
+			{
+				unsigned char out[EVP_MAX_MD_SIZE];
+				unsigned int length = 0;
+
+				if(EVP_DigestFinal_ex(mCtx, out, &length) != 1 or length < Digest().size())
+					throw Error(" Error ! Can't compute the digest .... ");
+
+				Digest d;
+				std::copy(out, out + d.size(), d.begin());
+				return d;
+			}
+
+		// One-shot digest
+		Digest compute(Algorithm a, const void* data, size_t size)
+			{
+				thread_local Context context;
+
+				context.start(a);
+				context.update(data, size);
+				return context.finish();
+			}
+
+		// Digest of a password
+		Digest password(Algorithm a, const string& key)
+			{
+				static Cache cache;
+				return cache.get(a, key);
+			}
+
+	}	// namespace 'hashing' closed.
+
+}	// namespace 'Steganography' closed.
@@ -0,0 +1,75 @@
+/**
+ * This file contains the definitions of 'Header' struct
+ * Declaration is in 'Header.h'
+ */
+
+#include <cstring>
+#include "Header.h"
+#include "Hash.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace Steganography
+{
+	const uint8_t Header::MAGIC[4] = { 0, 'S', 'T', 'G' };
+	
+	// Header of a payload
+	Header::Header(uint64_t length, uint8_t depth, bool scattered)
+			: version(VERSION), flags(0), depth(depth), digest(0), length(length)
+		{
+			if(depth > 1)
+				flags |= MULTIBIT;
+			if(scattered)
+				flags |= SCATTER;
+		}
+		
+	// Write the header
+	void Header::write(uint8_t* out) const
+		{
+			memcpy(out, MAGIC, 4);
+			out[4] = version;
+			out[5] = flags;
+			out[6] = (flags & MULTIBIT) ? depth : 0;
+			out[7] = digest;
+			
+			for(int i = 0; i < 8; ++i)
+				out[8 + i] = static_cast<uint8_t>(length >> (8*i));
+		}
+		
+	// Read the header
+	bool Header::read(const uint8_t* in)
+		{
+			// The older format starts with the text, which is never empty
+			if(in[0] != 0)
+				return false;
+				
+			if(memcmp(in, MAGIC, 4) != 0)
+				throw Error(" The image is not stego or it is corrupted ! ");
+				
+			version = in[4];
+			flags = in[5];
+			
+			if(version != VERSION)
+				throw Error(" Unsupported version of the stego-image ! ");
+				
+			if(flags & ~FLAGS)
+				throw Error(" Unsupported options in the stego-image ! ");
+				
+			depth = (flags & MULTIBIT) ? in[6] : 1;
+			if(depth < 1 or depth > 4)
+				throw Error(" The image is not stego or it is corrupted ! ");
+				
+			// Always 0 (SHA-1) before it was recorded
+			digest = in[7];
+			if(digest > hashing::BLAKE2B)
+				throw Error(" Unsupported options in the stego-image ! ");
+				
+			length = 0;
+			for(int i = 0; i < 8; ++i)
+				length |= static_cast<uint64_t>(in[8 + i]) << (8*i);
+				
+			return true;
+		}
+		
+} // namespace 'Steganography' closed.
@@ -0,0 +1,321 @@
+/**
+ * This file contains the definitions of 'ImageMap' class
+ * Declaration is in 'ImageMap.h'
+ */
+
+#include <cctype>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ImageMap.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	/** Reads the header of a PNM file (PPM or PAM) from memory */
+	class Cursor
+		{
+			private :
+				const uint8_t* mPos;
+				const uint8_t* mEnd;
+
+			public :
+				Cursor(const uint8_t* begin, const uint8_t* end) : mPos(begin), mEnd(end) {}
+
+				size_t offset(const uint8_t* begin) const
+					{
+						return mPos - begin;
+					}
+
+				// Skips blanks and comments
+				void skip()
+					{
+						while(mPos < mEnd and (isspace(*mPos) or *mPos == '#'))
+							{
+								if(*mPos == '#')
+									while(mPos < mEnd and *mPos != '\n')
+										++mPos;
+								else
+									++mPos;
+							}
+					}
+
+				// Reads a number after blanks and comments
+				bool number(int& n)
+					{
+						skip();
+						if(mPos == mEnd or not isdigit(*mPos))
+							return false;
+
+						for(n = 0; mPos < mEnd and isdigit(*mPos) and n < (1 << 24); ++mPos)
+							n = 10*n + (*mPos - '0');
+						return true;
+					}
+
+				// Reads a word after blanks and comments
+				string word()
+					{
+						skip();
+						const uint8_t* start = mPos;
+						while(mPos < mEnd and not isspace(*mPos))
+							++mPos;
+						return string(start, mPos);
+					}
+
+				// Skips the single blank ending a header
+				bool blank()
+					{
+						if(mPos == mEnd or not isspace(*mPos))
+							return false;
+						++mPos;
+						return true;
+					}
+		};
+
+	// Little-endian integers of a BMP header
+	uint32_t le32(const uint8_t* p)
+		{
+			return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+		}
+
+	uint16_t le16(const uint8_t* p)
+		{
+			return p[0] | (p[1] << 8);
+		}
+
+	// Lower case extension of a file name
+	string extension(const string& filename)
+		{
+			size_t dot = filename.rfind('.');
+			if(dot == string::npos or filename.find('/', dot) != string::npos)
+				return "";
+
+			string ext = filename.substr(dot + 1);
+			transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			return ext;
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Constructor
+	ImageMap::ImageMap(Mode mode, uint8_t* addr, size_t size)
+			: mMode(mode), mFormat(PPM), mAddr(addr), mSize(size), mDevice(0), mInode(0), mOffset(0), mCols(0), mRows(0),
+			  mStep(0), mOrder(RGB), mBottomUp(false)
+		{
+		}
+
+	// Map a file
+	shared_ptr<ImageMap> ImageMap::open(const string& filename, Mode mode)
+		{
+			int fd = ::open(filename.c_str(), (mode == SHARED) ? O_RDWR : O_RDONLY);
+			if(fd < 0)
+				return nullptr;
+
+			struct stat st;
+			if(fstat(fd, &st) != 0 or not S_ISREG(st.st_mode) or st.st_size < 16)
+				{
+					::close(fd);
+					return nullptr;
+				}
+
+			// A private mapping can be written even though the file is opened read-only
+			size_t size = static_cast<size_t>(st.st_size);
+			void* addr = mmap(NULL, size, PROT_READ | PROT_WRITE, (mode == SHARED) ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+			::close(fd);
+
+			if(addr == MAP_FAILED)
+				return nullptr;
+
+			shared_ptr<ImageMap> map(new ImageMap(mode, static_cast<uint8_t *>(addr), size));
+			map->mDevice = st.st_dev;
+			map->mInode = st.st_ino;
+			return map->parse() ? map : nullptr;
+		}
+
+	// Unmap the file
+	ImageMap::~ImageMap()
+		{
+			munmap(mAddr, mSize);
+		}
+
+	// Read the header
+	bool ImageMap::parse()
+		{
+			const uint8_t* end = mAddr + mSize;
+
+			if(mAddr[0] == 'P' and mAddr[1] == '6')
+				{
+					// PPM : "P6 <width> <height> <maxval>" and a single blank
+					Cursor c(mAddr + 2, end);
+					int max = 0;
+					if(not (c.number(mCols) and c.number(mRows) and c.number(max) and c.blank()) or max != 255)
+						return false;
+
+					mFormat = PPM;
+					mOffset = c.offset(mAddr);
+					mStep = 3 * static_cast<size_t>(mCols);
+				}
+			else if(mAddr[0] == 'P' and mAddr[1] == '7')
+				{
+					// PAM : "P7" then "<TOKEN> <value>" lines up to "ENDHDR"
+					Cursor c(mAddr + 2, end);
+					int depth = 0, max = 0;
+					string tupltype = "RGB";
+
+					for(string token = c.word(); token != "ENDHDR"; token = c.word())
+						{
+							bool ok = true;
+							if(token == "WIDTH")
+								ok = c.number(mCols);
+							else if(token == "HEIGHT")
+								ok = c.number(mRows);
+							else if(token == "DEPTH")
+								ok = c.number(depth);
+							else if(token == "MAXVAL")
+								ok = c.number(max);
+							else if(token == "TUPLTYPE")
+								tupltype = c.word();
+							else
+								ok = false;
+
+							if(not ok)
+								return false;
+						}
+
+					if(not c.blank() or depth != 3 or max != 255 or tupltype != "RGB")
+						return false;
+
+					mFormat = PAM;
+					mOffset = c.offset(mAddr);
+					mStep = 3 * static_cast<size_t>(mCols);
+				}
+			else if(mAddr[0] == 'B' and mAddr[1] == 'M' and mSize >= 54)
+				{
+					// BMP : only uncompressed 24 bits per pixel, a negative height means the rows are stored top-down
+					const uint8_t* info = mAddr + 14;
+					int32_t width = static_cast<int32_t>(le32(info + 4));
+					int32_t height = static_cast<int32_t>(le32(info + 8));
+
+					if(le32(info) < 40 or le16(info + 12) != 1 or le16(info + 14) != 24 or le32(info + 16) != 0
+							or width <= 0 or height == 0 or height == INT32_MIN)
+						return false;
+
+					mFormat = BMP;
+					mOffset = le32(mAddr + 10);
+					mCols = width;
+					mRows = (height < 0) ? -height : height;
+					mBottomUp = (height > 0);
+					mStep = (3 * static_cast<size_t>(mCols) + 3) / 4 * 4;		// Rows are padded to 4 bytes
+					mOrder = BGR;
+				}
+			else
+				return false;
+
+			// The pixels must all be in the file
+			return mCols > 0 and mRows > 0 and mOffset < mSize
+					and (mSize - mOffset) / mStep >= static_cast<size_t>(mRows);
+		}
+
+	/** Getters */
+
+	ImageMap::Mode ImageMap::mode() const
+		{
+			return mMode;
+		}
+
+	ImageMap::Format ImageMap::format() const
+		{
+			return mFormat;
+		}
+
+	uint8_t * ImageMap::pixels() const
+		{
+			return mAddr + mOffset;
+		}
+
+	uint8_t * ImageMap::row(int r) const
+		{
+			return mAddr + mOffset + (mBottomUp ? mRows - 1 - r : r) * mStep;
+		}
+
+	bool ImageMap::bottom_up() const
+		{
+			return mBottomUp;
+		}
+
+	int ImageMap::cols() const
+		{
+			return mCols;
+		}
+
+	int ImageMap::rows() const
+		{
+			return mRows;
+		}
+
+	size_t ImageMap::step() const
+		{
+			return mStep;
+		}
+
+	ChannelOrder ImageMap::order() const
+		{
+			return mOrder;
+		}
+
+	// Save the mapped image
+	bool ImageMap::save(const string& filename) const
+		{
+			static const char* extensions[][2] = { { "ppm", "pnm" }, { "pam", "pam" }, { "bmp", "dib" } };
+
+			string ext = extension(filename);
+			if(ext != extensions[mFormat][0] and ext != extensions[mFormat][1])
+				return false;
+
+			// Whether the file is the mapped one, it must then be rewritten without truncating it first
+			struct stat st;
+			bool same = (stat(filename.c_str(), &st) == 0 and st.st_dev == mDevice and st.st_ino == mInode);
+
+			if(same and mMode == SHARED)
+				{
+					sync();
+					return true;
+				}
+
+			// Otherwise write the mapping as it is, pages never modified come from the page cache
+			int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | (same ? 0 : O_TRUNC), 0644);
+			if(fd < 0)
+				throw IOError(" Error ! Can't write the image file .... ");
+
+			for(size_t done = 0; done < mSize; )
+				{
+					ssize_t n = ::write(fd, mAddr + done, mSize - done);
+					if(n <= 0)
+						{
+							::close(fd);
+							throw IOError(" Error ! Can't write the image file .... ");
+						}
+					done += static_cast<size_t>(n);
+				}
+
+			if(::close(fd) != 0)
+				throw IOError(" Error ! Can't write the image file .... ");
+
+			return true;
+		}
+
+	// Flush a shared mapping
+	void ImageMap::sync() const
+		{
+			if(msync(mAddr, mSize, MS_SYNC) != 0)
+				throw IOError(" Error ! Can't write the image file .... ");
+		}
+
+}	// namespace 'Steganography' closed.
@@ -0,0 +1,477 @@
+/**
+ * This file contains the definitions of 'JpegImage' class
+ * Declaration is in 'JpegImage.h'
+ */
+
+#include <cstdio>
+#include <csetjmp>
+#include <cstring>
+#include <vector>
+#include <chrono>
+#include <jpeglib.h>
+#include "JpegImage.h"
+#include "Formats.h"
+#include "Permutation.h"
+#include "Compression.h"
+#include "Cipher.h"
+#include "Hash.h"
+#include "util.h"
+#include "Error.h"
+
+using namespace std;
+
+using byte = uint8_t;
+using Clock = chrono::steady_clock;
+
+namespace
+{
+	using namespace Steganography;
+
+	/** Number of AC coefficients in a block */
+	const uint64_t AC = DCTSIZE2 - 1;
+
+	/** libjpeg's error manager, jumping back to the caller instead of exiting */
+	struct Failure
+		{
+			jpeg_error_mgr manager;
+			jmp_buf jump;
+		};
+
+	void fail(j_common_ptr info)
+		{
+			longjmp(reinterpret_cast<Failure *>(info->err)->jump, 1);
+		}
+
+	/**
+	 * Walks the blocks in the order of the permutation of the key, and the AC coefficients of each block in their order,
+	 * hiding or reading one bit in each coefficient of magnitude 2 or more, in the lowest bit of its magnitude.
+	 * The coefficients of a block are walked together, so a block is loaded once and not once per bit.
+	 */
+	class Walker
+		{
+			private :
+				const vector<JCOEF *>& mBlocks;
+				Permutation mOrder;
+				uint64_t mNext = 0;
+
+				/** The block being walked, and the index of its next AC coefficient (from 0) */
+				JCOEF* mBlock = NULL;
+				uint64_t mK = AC;
+
+				// The next coefficient carrying a bit
+				JCOEF* next()
+					{
+						while(true)
+							{
+								while(mK < AC)
+									{
+										JCOEF* c = mBlock + 1 + mK++;
+										if(*c >= 2 or *c <= -2)
+											return c;
+									}
+
+								if(mNext == mOrder.size())
+									throw Error(" The image is not stego or it is corrupted ! ");
+
+								mBlock = mBlocks[mOrder(mNext++)];
+								mK = 0;
+							}
+					}
+
+			public :
+				Walker(const vector<JCOEF *>& blocks, const KeySchedule& ks) : mBlocks(blocks), mOrder(ks.key(), blocks.size())
+					{
+					}
+
+				void write(const byte* bytes, size_t count)
+					{
+						for(size_t n = 0; n < count; ++n)
+							for(int b = 0; b < 8; ++b)
+								{
+									JCOEF* c = next();
+									JCOEF bit = (bytes[n] >> b) & 1;
+									*c = (*c > 0) ? ((*c & ~1) | bit) : -((-*c & ~1) | bit);
+								}
+					}
+
+				void read(byte* bytes, size_t count)
+					{
+						for(size_t n = 0; n < count; ++n)
+							{
+								byte v = 0;
+								for(int b = 0; b < 8; ++b)
+									{
+										JCOEF c = *next();
+										v |= static_cast<byte>(((c > 0) ? c : -c) & 1) << b;
+									}
+								bytes[n] = v;
+							}
+					}
+		};	// class 'Walker' closed.
+
+	/**
+	 * Reads the header and the digest of the key at the start of the walk, returns whether the digest matches (in
+	 * constant time). A wrong key reads garbage, which is no header. An encrypted text has a random salt instead of
+	 * the digest and its header masked with the key derived from it, as with 'MatImage::header()'.
+	 */
+	bool keyed(Walker& w, Header& h, const KeySchedule& ks)
+		{
+			byte bytes[Header::SIZE];
+			Digest hash;
+			w.read(bytes, Header::SIZE);
+			w.read(hash.data(), hash.size());
+
+			try
+				{
+					if(h.read(bytes) and not (h.flags & Header::ENCRYPTED)
+					   and same(ks.digest(static_cast<hashing::Algorithm>(h.digest)), hash))
+						return true;
+				}
+			catch(const Error&)
+				{
+				}
+
+			crypto::mask(ks.key(), hash.data(), bytes);
+			try
+				{
+					return h.read(bytes) and (h.flags & Header::ENCRYPTED);
+				}
+			catch(const Error&)
+				{
+					return false;
+				}
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	/** The decompressor keeps the coefficients in memory until it is destroyed */
+	struct JpegImage::Coefficients
+		{
+			jpeg_decompress_struct info;
+			Failure failure;
+			jvirt_barray_ptr* arrays = NULL;
+
+			/** The blocks of 64 coefficients of every component, row by row */
+			vector<JCOEF *> blocks;
+
+			Coefficients()
+				{
+					info.err = jpeg_std_error(&failure.manager);
+					failure.manager.error_exit = fail;
+					jpeg_create_decompress(&info);
+				}
+
+			~Coefficients()
+				{
+					jpeg_destroy_decompress(&info);
+				}
+
+			// Reads the coefficients (and the markers to copy), returns false on a corrupted file
+			bool read(FILE* file)
+				{
+					if(setjmp(failure.jump))
+						return false;
+
+					jpeg_stdio_src(&info, file);
+					jpeg_save_markers(&info, JPEG_COM, 0xFFFF);
+					for(int m = 0; m < 16; ++m)
+						jpeg_save_markers(&info, JPEG_APP0 + m, 0xFFFF);
+
+					jpeg_read_header(&info, TRUE);
+					arrays = jpeg_read_coefficients(&info);
+
+					// The arrays are in memory as a whole, so the blocks stay where they are
+					for(int ci = 0; ci < info.num_components; ++ci)
+						{
+							jpeg_component_info* comp = info.comp_info + ci;
+							for(JDIMENSION r = 0; r < comp->height_in_blocks; ++r)
+								{
+									JBLOCKARRAY row = info.mem->access_virt_barray(reinterpret_cast<j_common_ptr>(&info),
+																				   arrays[ci], r, 1, TRUE);
+									for(JDIMENSION c = 0; c < comp->width_in_blocks; ++c)
+										blocks.push_back(row[0][c]);
+								}
+						}
+
+					return true;
+				}
+
+			// Writes the coefficients, returns false if libjpeg fails
+			bool write(jpeg_compress_struct& out, Failure& f, FILE* file)
+				{
+					if(setjmp(f.jump))
+						return false;
+
+					jpeg_stdio_dest(&out, file);
+					jpeg_copy_critical_parameters(&info, &out);
+					out.optimize_coding = TRUE;
+					jpeg_write_coefficients(&out, arrays);
+
+					// The markers but the ones libjpeg writes itself (JFIF and Adobe), as 'jpegtran' does
+					for(jpeg_saved_marker_ptr m = info.marker_list; m; m = m->next)
+						{
+							if(out.write_JFIF_header and m->marker == JPEG_APP0 and m->data_length >= 5
+							   and memcmp(m->data, "JFIF", 5) == 0)
+								continue;
+							if(out.write_Adobe_marker and m->marker == JPEG_APP0 + 14 and m->data_length >= 5
+							   and memcmp(m->data, "Adobe", 5) == 0)
+								continue;
+
+							jpeg_write_marker(&out, m->marker, m->data, m->data_length);
+						}
+
+					jpeg_finish_compress(&out);
+					return true;
+				}
+		};
+
+	// Whether the file is a JPEG file
+	bool JpegImage::supported(const string& filename)
+		{
+			const formats::Format* f = formats::find(filename);
+			return f and f->coefficients;
+		}
+
+	// Read the coefficients
+	JpegImage::JpegImage(const string& filename) : mCoefficients(new Coefficients)
+		{
+			FILE* file = fopen(filename.c_str(), "rb");
+			if(not file)
+				throw IOError(" Error ! Can't open the image file .... ");
+
+			bool ok = mCoefficients->read(file);
+			fclose(file);
+
+			if(not ok or mCoefficients->blocks.empty())
+				throw IOError(" Error ! Can't decode the image file .... ");
+
+			for(const JCOEF* b : mCoefficients->blocks)
+				for(uint64_t k = 1; k <= AC; ++k)
+					if(b[k] >= 2 or b[k] <= -2)
+						++mUsable;
+		}
+
+	JpegImage::JpegImage(JpegImage&& image) = default;
+	JpegImage& JpegImage::operator=(JpegImage&& image) = default;
+
+	JpegImage::~JpegImage()
+		{
+		}
+
+	long JpegImage::cols() const
+		{
+			return static_cast<long>(mCoefficients->info.image_width);
+		}
+
+	long JpegImage::rows() const
+		{
+			return static_cast<long>(mCoefficients->info.image_height);
+		}
+
+	// Bytes the coefficients carry, less the header and the digest
+	long JpegImage::max() const
+		{
+			long bytes = static_cast<long>(mUsable / 8) - static_cast<long>(PREFIX);
+			return (bytes > 0) ? bytes : 0;
+		}
+
+	// Options of 'steg()'
+	void JpegImage::set_options(const StegOptions& options)
+		{
+			if(options.depth != 1)
+				throw Error(" A JPEG image hides 1 bit per coefficient only ! ");
+
+			if(options.scatter)
+				throw Error(" The text is always spread over a JPEG image, it can't be scattered ! ");
+
+			mOptions = options;
+		}
+
+	const StegReport& JpegImage::report() const
+		{
+			return mReport;
+		}
+
+	// Hide the bytes
+	JpegImage& JpegImage::steg(const byte* data, size_t size, const KeySchedule& ks)
+		{
+			Clock::time_point start = Clock::now();
+			mReport = StegReport();
+			mReport.raw = size;
+
+			if(size == 0)
+				throw TextEmptyError();
+
+			Header h(0, 1, true);
+			h.digest = static_cast<uint8_t>(mOptions.digest);
+
+			// Compress the text, as 'MatImage::steg()' does
+			vector<byte> packed;
+			if(mOptions.codec != compression::NONE)
+				{
+					packed = compression::compress(mOptions.codec, mOptions.level, data, size);
+					if(packed.size() < size)
+						{
+							data = packed.data();
+							size = packed.size();
+							h.flags |= Header::COMPRESSED;
+						}
+				}
+
+			Clock::time_point compressed = Clock::now();
+
+			// Check the capacity before changing anything
+			size_t prefix = (mOptions.cipher != crypto::NONE) ? crypto::Envelope::SIZE : 0;
+			if(static_cast<uint64_t>(PREFIX + prefix + size) > mUsable / 8)
+				throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+
+			// Encrypt it after its envelope
+			vector<byte> sealed;
+			if(prefix)
+				{
+					crypto::Envelope e;
+					e.algorithm = mOptions.cipher;
+					e.iterations = mOptions.iterations;
+					h.flags |= Header::ENCRYPTED;
+					crypto::Cipher c(crypto::Cipher::ENCRYPT, ks.key(), e, h);
+
+					sealed.resize(prefix + size);
+					c.update(data, sealed.data() + prefix, size);
+					c.finish(e);
+					e.write(sealed.data());
+
+					data = sealed.data();
+					size = sealed.size();
+				}
+
+			h.length = size;
+			byte header[Header::SIZE];
+			h.write(header);
+			// A random salt for an encrypted text, and its header masked, as 'MatImage::set_key()' and 'conceal()'
+			Digest hash;
+			if(prefix)
+				{
+					crypto::random(hash.data(), hash.size());
+					crypto::mask(ks.key(), hash.data(), header);
+				}
+			else
+				hash = ks.digest(mOptions.digest);
+
+			Walker w(mCoefficients->blocks, ks);
+			w.write(header, Header::SIZE);
+			w.write(hash.data(), hash.size());
+			w.write(data, size);
+
+			mReport.stored = size;
+			mReport.compress = chrono::duration<double>(compressed - start).count();
+			mReport.embed = chrono::duration<double>(Clock::now() - compressed).count();
+
+			return (*this);
+		}
+
+	// Probe for a text hidden with the key
+	bool JpegImage::is_stego(const KeySchedule& ks) const
+		{
+			if(mUsable / 8 < PREFIX)
+				return false;
+
+			Header h;
+			Walker w(mCoefficients->blocks, ks);
+			return keyed(w, h, ks);
+		}
+
+	// The payload as it is stored
+	string JpegImage::stored(Header& h, const KeySchedule& ks) const
+		{
+			if(mUsable / 8 < PREFIX)
+				throw InsufficientImageError(" The image is not stego ");
+
+			Walker w(mCoefficients->blocks, ks);
+			if(not keyed(w, h, ks))
+				throw KeyMismatchError();
+
+			// The length must fit in the image
+			if(h.length > static_cast<uint64_t>(max()))
+				throw Error(" The image is not stego or it is corrupted ! ");
+
+			string text(static_cast<size_t>(h.length), '\0');
+			if(not text.empty())
+				w.read(reinterpret_cast<byte *>(&text[0]), text.size());
+
+			return (text);
+		}
+
+	// Unsteg
+	string JpegImage::unsteg(const KeySchedule& ks) const
+		{
+			Header h;
+			string text = stored(h, ks);
+
+			// Nothing is returned unless the tag matches
+			if(h.flags & Header::ENCRYPTED)
+				{
+					if(text.size() < crypto::Envelope::SIZE)
+						throw Error(" The image is not stego or it is corrupted ! ");
+
+					byte * bytes = reinterpret_cast<byte *>(&text[0]);
+					crypto::Envelope e;
+					e.read(bytes);
+					crypto::Cipher c(crypto::Cipher::DECRYPT, ks.key(), e, h);
+
+					string plain(text.size() - crypto::Envelope::SIZE, '\0');
+					c.update(bytes + crypto::Envelope::SIZE, reinterpret_cast<byte *>(&plain[0]), plain.size());
+					c.finish(e);
+					text.swap(plain);
+				}
+
+			if(h.flags & Header::COMPRESSED)
+				return compression::decompress(reinterpret_cast<const byte *>(text.data()), text.size());
+
+			return (text);
+		}
+
+	// Digest of the payload as it is stored
+	Digest JpegImage::fingerprint(const KeySchedule& ks) const
+		{
+			Header h;
+			string text = stored(h, ks);
+
+			byte bytes[Header::SIZE];
+			h.write(bytes);
+
+			hashing::Context c;
+			c.start(hashing::SHA256);
+			c.update(bytes, Header::SIZE);
+			c.update(text.data(), text.size());
+			return c.finish();
+		}
+
+	// Write the coefficients
+	void JpegImage::save(const string& filename) const
+		{
+			FILE* file = fopen(filename.c_str(), "wb");
+			if(not file)
+				throw IOError(" Error ! Can't write the image file .... ");
+
+			jpeg_compress_struct out;
+			Failure f;
+			out.err = jpeg_std_error(&f.manager);
+			f.manager.error_exit = fail;
+			jpeg_create_compress(&out);
+
+			bool ok = mCoefficients->write(out, f, file);
+			jpeg_destroy_compress(&out);
+
+			if(fclose(file) != 0)
+				ok = false;
+
+			if(not ok)
+				{
+					remove(filename.c_str());
+					throw IOError(" Error ! Can't write the image file .... ");
+				}
+		}
+
+}	// namespace 'Steganography' closed.
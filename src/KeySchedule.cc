@@ -0,0 +1,101 @@
+/**
+ * This file contains the definitions of 'KeySchedule' class
+ * Declaration is in 'KeySchedule.h'
+ */
+
+#include "KeySchedule.h"
+#include "Error.h"
+#include "util.h"
+
+using namespace std;
+
+using uint = unsigned int;
+
+namespace Steganography
+{
+	// Precompute the choices for one period of the key
+	KeySchedule::KeySchedule(const string& key) : mKey(key)
+		{
+			if(key.empty())
+				throw KeyEmptyError();
+				
+			mDigest = hashing::password(hashing::SHA1, key);
+
+			// Every byte consumes 9 characters, so the period is 'lcm(length, 9) / 9' bytes
+			size_t length = key.size();
+			size_t gcd = (length % 9 == 0) ? 9 : (length % 3 == 0) ? 3 : 1;
+			size_t period = length / gcd;
+
+			mTable.resize(period);
+
+			size_t k = 0;	// Position of the key character
+			for(size_t n = 0; n < period; ++n)
+				{
+					Entry& e = mTable[n];
+
+					/**
+					 * Characters are converted to 'unsigned int' exactly as the original iterator walking did,
+					 * so keys with non-ASCII characters keep choosing the same colors and planes.
+					 */
+					uint ignore = static_cast<uint>(key[k]);
+					e.ignore = ignore % 9;
+					e.hignore = ignore % 8;
+					if(++k == length) k = 0;
+
+					e.planes = 0;
+					for(int b = 0; b < 8; ++b)
+						{
+							e.planes |= (static_cast<uint>(key[k]) % 2) << b;
+							if(++k == length) k = 0;
+						}
+				}
+				
+			// Expand the text choices to per sample masks, in both channel orders
+			for(int order = RGB; order <= BGR; ++order)
+				{
+					mBits[order].resize(9*(period + SPAN));
+					mPlanes[order].resize(9*(period + SPAN));
+				}
+			
+			for(size_t n = 0; n < period + SPAN; ++n)
+				{
+					const Entry& e = mTable[n % period];
+					for(uint i = 0; i < 9; ++i)
+						{
+							uint used = (i != e.ignore);
+							uint b = i - (i > e.ignore);
+							uint8_t bit = used << b;
+							uint8_t plane = used << ((e.planes >> b) & 1);
+							
+							mBits[RGB][9*n + i] = bit;
+							mPlanes[RGB][9*n + i] = plane;
+							mBits[BGR][9*n + bitplane::bgr(i)] = bit;
+							mPlanes[BGR][9*n + bitplane::bgr(i)] = plane;
+						}
+				}
+		}
+
+	// Return the key
+	const string& KeySchedule::key() const
+		{
+			return mKey;
+		}
+
+	// Return the digest
+	const Digest& KeySchedule::digest() const
+		{
+			return mDigest;
+		}
+		
+	Digest KeySchedule::digest(hashing::Algorithm a) const
+		{
+			return (a == hashing::SHA1) ? mDigest : hashing::password(a, mKey);
+		}
+		
+	// Return the period
+	size_t KeySchedule::period() const
+		{
+			return mTable.size();
+		}
+
+} // namespace 'Steganography' closed.
@@ -5,23 +5,144 @@
  
 #include <string>
 #include <iostream>
-#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include "MatImage.h"
+#include "bitplane.h"
+#include "simd.h"
+#include "Header.h"
+#include "Permutation.h"
+#include "Cipher.h"
 #include "util.h"
 #include "Error.h"
 
 using namespace cv;
 using namespace std;
-using Glib::RefPtr;
-using Gdk::Pixbuf;
 
 using byte = uint8_t;
 using uint = unsigned int;
+using Clock = chrono::steady_clock;
+
+namespace
+{
+	/**
+	 * Walks 'count' groups of 3 pixels (9 samples) of 'mat', starting at pixel 'first' (counted row by row), and calls
+	 * 'fn(samples, n, run)' for every run of 'run' groups lying contiguously in memory, 'n' being the index of its
+	 * first group. A group crossing the end of a row of a non-continuous image is copied to a local buffer and passed
+	 * alone, then copied back if 'write' is true.
+	 */
+	template<class Fn>
+	void for_each_group(const Mat& mat, long first, size_t count, bool write, Fn fn)
+		{
+			byte * data = const_cast<byte *>(mat.data);
+			
+			// Loaded images are continuous, so this is the usual case
+			if(mat.isContinuous())
+				{
+					fn(data + 3*first, 0, count);
+					return;
+				}
+				
+			long cols = mat.cols;
+			long row = first / cols, col = first % cols;
+			
+			for(size_t n = 0; n < count; )
+				{
+					// Groups lying completely in the row
+					size_t run = std::min(static_cast<size_t>((cols - col) / 3), count - n);
+					if(run > 0)
+						{
+							fn(data + row*mat.step + 3*col, n, run);
+							n += run;
+							col += 3*run;
+						}
+						
+					if(n == count)
+						break;
+						
+					if(col == cols)
+						{
+							++row;
+							col = 0;
+							continue;
+						}
+						
+					// The group crossing the end of the row
+					byte tmp[9];
+					long r = row, c = col;
+					for(int px = 0; px < 3; ++px)
+						{
+							std::memcpy(tmp + 3*px, data + r*mat.step + 3*c, 3);
+							if(++c == cols) { c = 0; ++r; }
+						}
+						
+					fn(tmp, n, 1);
+					
+					if(write)
+						for(int px = 0; px < 3; ++px)
+							{
+								std::memcpy(data + row*mat.step + 3*col, tmp + 3*px, 3);
+								if(++col == cols) { col = 0; ++row; }
+							}
+					else
+						{
+							row = r;
+							col = c;
+						}
+						
+					++n;
+				}
+		}
+		
+	/** Number of bytes hidden or read by one task of 'for_each_chunk()' */
+	const size_t CHUNK = 1 << 16;
+	
+	/** Calls 'fn(first, count)' for every chunk of the range, see 'for_each_chunk()' */
+	template<class Fn>
+	class ChunkBody : public ParallelLoopBody
+		{
+			private :
+				size_t mCount;
+				Fn mFn;
+				
+			public :
+				ChunkBody(size_t count, Fn fn) : mCount(count), mFn(fn) {}
+				
+				void operator()(const Range& r) const
+					{
+						for(int c = r.start; c < r.end; ++c)
+							{
+								size_t first = c * CHUNK;
+								mFn(first, std::min(CHUNK, mCount - first));
+							}
+					}
+		};
+		
+	/**
+	 * Splits 'count' bytes into chunks of 'CHUNK' bytes and calls 'fn(first, count)' for every chunk on OpenCV's
+	 * thread pool. A byte depends only on its own pixels and on its position in the key schedule, which is known in
+	 * closed form, so the chunks are independent. A single chunk is done on the calling thread.
+	 */
+	template<class Fn>
+	void for_each_chunk(size_t count, Fn fn)
+		{
+			size_t chunks = (count + CHUNK - 1) / CHUNK;
+			
+			if(chunks <= 1)
+				fn(0, count);
+			else
+				parallel_for_(Range(0, static_cast<int>(chunks)), ChunkBody<Fn>(count, fn));
+		}
+		
+}	// Unnamed namespace closed.
 
 namespace Steganography
 {
 	// Open an image file
-	MatImage::MatImage(const string& filename)
+	MatImage::MatImage(const string& filename) : mOrder(BGR)
 		{
 			mMat = imread(filename, CV_LOAD_IMAGE_COLOR);  // Loads the image from given file name with its default color
 			
@@ -30,47 +151,71 @@ namespace Steganography
 				throw IOError(" Error ! Can't open the image file .... ");
 				
 			/**
-			 * If all is ok, then convert the image from BGR to RGB format using method 'cvtColor()'
-			 * This is required since OpenCV loads the image as BGR and GTK also requires the image in RGB
-			 * to display correctly
+			 * OpenCV loads the image as BGR, it is kept so: the embedding maps the channels itself and only the GTK
+			 * side ('PixbufImage::pixbuf()') needs RGB, so it converts when it is asked to
 			 */
-			 cvtColor(mMat, mMat, CV_BGR2RGB);
 		}
 		
-	// Create from 'Gdk::Pixbuf'
-	MatImage::MatImage(const Glib::RefPtr<Gdk::Pixbuf>& p)
+	// Open an image file decoding its rows on demand
+	MatImage MatImage::stream(const string& filename)
 		{
-			// Copy the 'Gdk::Pixbuf'
-			RefPtr<Pixbuf> pp = p->copy();
+			// A mapped file is read page by page as the rows are used, which is even cheaper
+			shared_ptr<ImageMap> m = ImageMap::open(filename);
+			if(m and not m->bottom_up())
+				return MatImage(m);
+				
+			shared_ptr<RowReader> reader = RowReader::open(filename);
+			if(not reader)
+				return MatImage(filename);
+				
+			// The pixels are allocated but only written as the rows are decoded
+			MatImage image;
+			image.mMat.create(reader->rows(), reader->cols(), CV_8UC3);
+			image.mOrder = reader->order();
+			image.mReader = reader;
 			
-			// Then convert into 'cv::mMat'
-			mMat = Mat(
-						Size(pp->get_width(), pp->get_height()),		// Dimensions
-						CV_8UC3,										// Type
-						pp->get_pixels(),								// Pointer to the data
-						pp->get_rowstride()								// Bytes per row
-					  );
-					
-			/**
-			 * Any primitive type from the list can be defined by an identifier in the form 
-			 * 'CV_<bit-depth>{U|S|F}C(<number_of_channels>)'
-			 * where U is unsigned integer type, S is signed integer type, and F is float type, C means channels.
-			 * so CV_8UC3 is an 8-bit unsigned integer matrix/image with 3 channels. 
-			 * Although it is most common that this means an RGB (or actually BGR) image, it does not mandate it. 
-			 * It simply means that there are three channels, and how you use them is up to you and your application. 
-			 */
+			return image;
+		}
+		
+	// Open an image file by mapping it
+	MatImage MatImage::map(const string& filename, ImageMap::Mode mode)
+		{
+			shared_ptr<ImageMap> m = ImageMap::open(filename, mode);
+			if(not m or m->bottom_up())
+				return MatImage(filename);
+				
+			return MatImage(m);
+		}
+		
+	// View of the pixels of a mapped file, the mapping lives as long as the image
+	MatImage::MatImage(const shared_ptr<ImageMap>& map)
+			: MatImage(map->pixels(), map->cols(), map->rows(), map->step(), map->order())
+		{
+			mMap = map;
+		}
+		
+	// View of a 'cv::Mat'
+	MatImage::MatImage(Mat& mat, ChannelOrder order) : mMat(mat), mOrder(order)
+		{
+			// Only the header is copied, the pixels are shared with 'mat'
+			if(not mMat.empty() and mMat.type() != CV_8UC3)
+				throw Error(" Error ! The image should have 3 channels of 8 bits .... ");
 		}
 		
-	// Create from 'cv::Mat'
-	MatImage::MatImage(const Mat& mat)
+	// View of an external buffer
+	MatImage::MatImage(byte* data, int cols, int rows, size_t step, ChannelOrder order)
+			: mMat(rows, cols, CV_8UC3, data, step), mOrder(order)
 		{
-			mMat = mat.clone();
 		}
 		
-	// Copy constructor
-	MatImage::MatImage(const MatImage& image)
+	// Deep copy
+	MatImage MatImage::clone() const
 		{
-			mMat = image.mMat.clone();
+			decode(rows());
+			Mat copy = mMat.clone();
+			MatImage image(copy, mOrder);
+			image.mOptions = mOptions;
+			return image;
 		}
 		
 	// Destructor
@@ -82,12 +227,100 @@ namespace Steganography
 	// Save image with given file name to disk
 	void MatImage::save(const string& filename)const
 		{
-			// Again convert RGB to BGR format then proceed to save
+			decode(rows());
+			
+			// A mapped image still in the order of its file is written as it is to a file of its own format
+			if(mMap and mMat.data == mMap->pixels() and mOrder == mMap->order() and mMap->save(filename))
+				return;
+				
+			// OpenCV saves BGR, so only an image in RGB order needs a converted copy
+			if(mOrder == BGR)
+				{
+					imwrite(filename, mMat);
+					return;
+				}
+				
 			Mat bgr;
 			cvtColor(mMat, bgr, CV_RGB2BGR);
 			imwrite(filename, bgr);
 		}
 		
+	// Save image with the given PNG settings
+	void MatImage::save(const string& filename, const PngSettings& png)const
+		{
+			if(empty() or not RowWriter::supported(filename))
+				{
+					save(filename);
+					return;
+				}
+				
+			decode(rows());
+			
+			shared_ptr<RowWriter> writer = RowWriter::open(filename, static_cast<int>(cols()), static_cast<int>(rows()),
+														   mOrder, png);
+			
+			// The rows of a view may not be contiguous
+			for(int r = 0; r < rows(); ++r)
+				writer->encode(mMat.ptr(r), step(), 1);
+		}
+		
+	// Save only the pixels modified
+	void MatImage::update(const string& filename)const
+		{
+			// The file is the one mapped, so it is already up to date
+			if(mMap and mMap->mode() == ImageMap::SHARED and mMap->save(filename))
+				return;
+				
+			// Otherwise the file must have fixed row offsets and the size of the image, else it is encoded again
+			shared_ptr<ImageMap> file = ImageMap::open(filename, ImageMap::SHARED);
+			if(not file or file->cols() != cols() or file->rows() != rows())
+				{
+					save(filename);
+					return;
+				}
+				
+			// Copy every modified range row by row, in the order of the channels of the file
+			bool swap = (file->order() != mOrder);
+			
+			for(const pair<long, long>& t : mTouched)
+				for(long first = t.first; first < t.second; )
+					{
+						long r = first / cols(), c = first % cols();
+						long count = std::min(t.second - first, cols() - c);
+						
+						const byte * src = mMat.ptr(static_cast<int>(r)) + 3*c;
+						byte * dst = file->row(static_cast<int>(r)) + 3*c;
+						
+						if(swap)
+							for(long px = 0; px < 3*count; px += 3)
+								{
+									dst[px] = src[px + 2];
+									dst[px + 1] = src[px + 1];
+									dst[px + 2] = src[px];
+								}
+						else
+							std::memcpy(dst, src, 3*count);
+							
+						first += count;
+					}
+					
+			file->sync();
+		}
+		
+	// Convert the pixels in place
+	void MatImage::convert(ChannelOrder order)
+		{
+			if(order == mOrder or mMat.empty())
+				{
+					mOrder = order;
+					return;
+				}
+				
+			decode(rows());
+			cvtColor(mMat, mMat, (order == RGB) ? CV_BGR2RGB : CV_RGB2BGR);
+			mOrder = order;
+		}
+		
 	/** Getters */
 	
 	long MatImage::cols() const
@@ -117,339 +350,968 @@ namespace Steganography
 		
 	byte * MatImage::data() const
 		{
+			decode(rows());
 			return mMat.data;	// Returns the pointer to pixel array
 		}
 		
+	ChannelOrder MatImage::order() const
+		{
+			return mOrder;	// Returns the order of the channels of the pixel array
+		}
+		
 	long MatImage::max() const
 		{
-			return (cols()*(rows()-1))/3;	// Returns the maximum size of text that this image can hide
+			return max(mOptions.depth);	// Returns the maximum size of text that this image can hide with the current depth
 		}
 		
-	bool MatImage::empty() const
+	long MatImage::max(unsigned bits) const
 		{
-			return mMat.empty();	// Check whether the image is empty or not
+			// Returns the maximum size of text that this image can hide, i.e. 'bits' bytes per 3 pixels after the
+			// first row minus the header (always 1 byte per 3 pixels)
+			long groups = (cols()*(rows()-1))/3 - static_cast<long>(Header::SIZE);
+			return (groups > 0) ? groups * bits : 0;
+		}
+		
+	unsigned MatImage::depth() const
+		{
+			return mOptions.depth;	// Returns the number of bits hidden per sample
 		}
 		
-	// Converts the image to 'Gdk::Pixbuf' object
-	RefPtr<Pixbuf> MatImage::pixbuf() const
+	bool MatImage::scattered() const
 		{
-			return Gdk::Pixbuf::create_from_data(
-													mMat.data,				// Pointer to the pixels array
-													Gdk::COLORSPACE_RGB,	// Colorspace RGB only
-													false,					// Transparancy ?
-													8,						// Bits per sample always 8
-													mMat.cols,				// Width
-													mMat.rows,				// Height
-													mMat.step				// Bytes per row ('get_rowstride()' or 'step')
-												);
+			return mOptions.scatter;	// Whether the text is spread over the image
 		}
 		
-	// Scales the image to the desired size
-	RefPtr<Pixbuf> MatImage::scale(int width, int height) const
+	// Set the number of bits hidden per sample
+	void MatImage::set_depth(unsigned bits)
 		{
-			// Both width and height can't be zero
-			if(width<=0 and height<=0)
-				throw invalid_argument("Both width and height can not be zero at same time");
+			if(bits < 1 or bits > 4)
+				throw Error(" The number of bits per sample should be from 1 to 4 ! ");
 				
-			// Get aspect ratio of original image
-			double ratio = static_cast<double>(cols())/rows();
-			/**
-			 * 'static_cast' is used for cases where you basically want to reverse an implicit conversion, 
-			 * with a few restrictions and additions. static_cast performs no runtime checks. 
-			 * This should be used if you know that you refer to an object of a specific type, 
-			 * and thus a check would be unnecessary.
-			 * 
-			 * 'dynamic_cast' is useful when you don't know what the dynamic type of the object is. 
-			 * It returns a null pointer
-			 * if the object referred to doesn't contain the type casted to as a base class 
-			 * (when you cast to a reference, a bad_cast exception is thrown in that case).
-			 */
-			 
-			 // Now either width or height is zero then adjust it to maintain the ratio
-			 if(width<=0)
-			 	width = height*ratio;
-			 else if(height<=0)
-			 	height=width/ratio;
-			 	
-			 // Now scale the image & return
-			 return this->pixbuf()->scale_simple(width, height, Gdk::INTERP_BILINEAR);
+			mOptions.depth = bits;
 		}
-	
-	// Returns the scaled image that fit into the given dimenstion
-	RefPtr<Pixbuf> MatImage::fit(int width, int height) const
+		
+	// Spread the text over the image or not
+	void MatImage::set_scatter(bool on)
+		{
+			mOptions.scatter = on;
+		}
+		
+	// Compress the text or not
+	void MatImage::set_compression(compression::Codec codec, int level)
 		{
-			// Width or height must not be zero
-			if(width<1 or height<1)
-				throw invalid_argument("Width and height should be greater than zero ! ");
+			if(not compression::available(codec))
+				throw Error(" The codec '" + compression::name(codec) + "' is not available in this build ! ");
 				
-			// Get ratio of window
-			double win_ratio = static_cast<double>(width)/height;
-			// Now, get ratio of image
-			double img_ratio = static_cast<double>(cols())/rows();
-			
-			// Fit the image 
-			if( win_ratio > img_ratio )
-				return this->scale(0, height);
-			else
-				return this->scale(width, 0);
+			mOptions.codec = codec;
+			mOptions.level = level;
+		}
+		
+	// Encrypt the payload or not
+	void MatImage::set_encryption(crypto::Algorithm algorithm, uint32_t iterations)
+		{
+			if(iterations == 0 or iterations > crypto::Envelope::MAX_ITERATIONS)
+				throw Error(" Invalid number of iterations of the key derivation ! ");
+				
+			mOptions.cipher = algorithm;
+			mOptions.iterations = iterations;
+		}
+		
+	// Choose the digest of the key
+	void MatImage::set_digest(hashing::Algorithm algorithm)
+		{
+			mOptions.digest = algorithm;
+		}
+		
+	const StegOptions& MatImage::options() const
+		{
+			return mOptions;	// Returns the options of 'steg()'
+		}
+		
+	// Set all the options
+	void MatImage::set_options(const StegOptions& options)
+		{
+			set_depth(options.depth);
+			set_scatter(options.scatter);
+			set_compression(options.codec, options.level);
+			set_encryption(options.cipher, options.iterations);
+			set_digest(options.digest);
 		}
 		
-	// Display the image using OpenCV 
-	void MatImage::show(int msecs) const
+	const StegReport& MatImage::report() const
 		{
-			// Create a window
-			namedWindow("MatImage", CV_WINDOW_NORMAL);
-			// Display image in the window
-			imshow("MatImage", mMat);
-			// Wait for 'msecs'
-			waitKey(msecs);			
+			return mReport;	// Returns what the last 'steg()' did
+		}
+		
+	bool MatImage::empty() const
+		{
+			return mMat.empty();	// Check whether the image is empty or not
 		}
 		
 	// Steg definition
 	MatImage& MatImage::steg(const string& text, const string& key)
 		{
-			// Check for exceptions
-			if(empty())
-				throw ImageEmptyError();
-				
-			if(text.empty())
-				throw TextEmptyError();
+			if(key.empty())
+				throw KeyEmptyError();
 				
+			return steg(text, KeySchedule(key));
+		}
+		
+	// Steg with a prebuilt key schedule
+	MatImage& MatImage::steg(const string& text, const KeySchedule& ks)
+		{
+			return steg(reinterpret_cast<const byte *>(text.data()), text.size(), ks);
+		}
+		
+	// Steg a binary payload
+	MatImage& MatImage::steg(const byte* data, size_t size, const string& key)
+		{
 			if(key.empty())
 				throw KeyEmptyError();
 				
-			if(cols() < 80)
-				throw InsufficientImageError(" Size error :Image is of too small size ! ");
+			return steg(data, size, KeySchedule(key));
+		}
+		
+	MatImage& MatImage::steg(const byte* data, size_t size, const KeySchedule& ks)
+		{
+			Clock::time_point start = Clock::now();
+			mReport = StegReport();
+			mReport.raw = size;
 			
-			if(text.size() >= max())
-				throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+			// Compress the text first, the capacity is then checked against what is really hidden
+			vector<byte> packed;
+			if(mOptions.codec != compression::NONE)
+				{
+					if(size == 0)
+						throw TextEmptyError();
+						
+					// A text that does not compress is hidden as it is
+					packed = compression::compress(mOptions.codec, mOptions.level, data, size);
+					if(packed.size() < size)
+						{
+							data = packed.data();
+							size = packed.size();
+						}
+					else
+						packed.clear();
+				}
+				
+			Clock::time_point compressed = Clock::now();
+			mReport.stored = size;
+			mReport.compress = chrono::duration<double>(compressed - start).count();
+			
+			// Check for exceptions, an encrypted payload also holds its envelope
+			size_t prefix = (mOptions.cipher != crypto::NONE) ? crypto::Envelope::SIZE : 0;
+			check(size, prefix);
+			mReport.stored = prefix + size;
 			
 			// If everything is valid, then proceed to 'steg'
 			
 			// First steg the key using 'set_key()'
-			set_key(key);
+			set_key(ks);
 			
-			// After that, steg the text using 'conceal()'
-			conceal(text, key);
+			// After that, steg the payload using 'conceal()'
+			conceal(data, size, not packed.empty(), ks);
+			
+			mReport.embed = chrono::duration<double>(Clock::now() - compressed).count();
 			
 			return (*this);
 		}
 		
+	// Steg a stream
+	MatImage& MatImage::steg(istream& in, const string& key)
+		{
+			if(key.empty())
+				throw KeyEmptyError();
+				
+			return steg(in, KeySchedule(key));
+		}
+		
+	MatImage& MatImage::steg(istream& in, const KeySchedule& ks)
+		{
+			// A compressed text is hidden once all of it is compressed
+			if(mOptions.codec != compression::NONE)
+				{
+					string text((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+					if(in.bad())
+						throw IOError(" Error ! Can't read the text .... ");
+						
+					return steg(text, ks);
+				}
+				
+			Clock::time_point began = Clock::now();
+			
+			// An encrypted payload starts with its envelope, written last once the tag is known
+			Header h(0, mOptions.depth, mOptions.scatter);
+			h.digest = static_cast<uint8_t>(mOptions.digest);
+			size_t prefix = 0;
+			crypto::Envelope e;
+			unique_ptr<crypto::Cipher> c;
+			
+			if(mOptions.cipher != crypto::NONE)
+				{
+					h.flags |= Header::ENCRYPTED;
+					prefix = crypto::Envelope::SIZE;
+					e.algorithm = mOptions.cipher;
+					e.iterations = mOptions.iterations;
+					c.reset(new crypto::Cipher(crypto::Cipher::ENCRYPT, ks.key(), e, h));
+				}
+				
+			// If the stream is seekable (e.g. a file), check its size before modifying anything
+			istream::pos_type start = in.tellg();
+			if(start != istream::pos_type(-1) and in.seekg(0, ios::end))
+				{
+					check(static_cast<size_t>(in.tellg() - start), prefix);
+					in.seekg(start);
+				}
+			else
+				{
+					in.clear();
+					check(1, prefix);
+				}
+				
+			// Hide the payload block by block as it is read (and encrypted), the header goes last when the size is known
+			vector<char> block(4*CHUNK);
+			size_t size = 0;
+			
+			while(in.read(block.data(), block.size()) or in.gcount() > 0)
+				{
+					size_t count = static_cast<size_t>(in.gcount());
+					byte * bytes = reinterpret_cast<byte *>(block.data());
+					
+					if(prefix + size + count > static_cast<size_t>(max()))
+						throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+						
+					if(c)
+						c->update(bytes, bytes, count);
+						
+					put(bytes, count, prefix + size, h, ks);
+					size += count;
+				}
+				
+			if(size == 0)
+				throw TextEmptyError();
+				
+			if(c)
+				{
+					byte envelope[crypto::Envelope::SIZE];
+					c->finish(e);
+					e.write(envelope);
+					put(envelope, prefix, 0, h, ks);
+				}
+				
+			set_key(ks);
+			
+			byte header[Header::SIZE];
+			h.length = prefix + size;
+			h.write(header);
+			if(c)
+				crypto::mask(ks.key(), hash(ks).data(), header);	// The salt is at the start of the first row
+			embed(header, Header::SIZE, 0, ks);
+			
+			mReport = StegReport();
+			mReport.raw = size;
+			mReport.stored = prefix + size;
+			mReport.embed = chrono::duration<double>(Clock::now() - began).count();
+			
+			return (*this);
+		}
+		
+	// Probe for a text hidden with the key
+	bool MatImage::is_stego(const string& key)const
+		{
+			if(key.empty())
+				throw KeyEmptyError();
+				
+			return is_stego(KeySchedule(key));
+		}
+		
+	bool MatImage::is_stego(const KeySchedule& ks)const
+		{
+			// Only the first rows are read (and decoded for an image opened with 'stream()')
+			if(empty() or cols() < 80)
+				return false;
+				
+			return keyed(ks);
+		}
+		
 	// Unsteg definitions
 	string MatImage::unsteg(const string& key)const
+		{
+			if(key.empty())
+				throw KeyEmptyError();
+				
+			return unsteg(KeySchedule(key));
+		}
+		
+	// Unsteg with a prebuilt key schedule
+	string MatImage::unsteg(const KeySchedule& ks)const
 		{
 			// Check for the necessary conditions first
-			assert(sha(key).size()==20);
+			verify();
 			
-			if(empty())
-				throw ImageEmptyError();
+			Header h;
+			if(not header(h, ks))
+				return reveal_legacy(ks);
 				
-			if(cols() < 80)
-				throw InsufficientImageError(" The image is not stego ");
+			// Decrypt and return the key
+			return reveal(h, ks);
+		}
+		
+	// Unsteg to a stream
+	void MatImage::unsteg(const string& key, ostream& out)const
+		{
+			if(key.empty())
+				throw KeyEmptyError();
 				
-			if(sha(key) != hash(key))
-				throw KeyMismatchError();
+			unsteg(KeySchedule(key), out);
+		}
+		
+	void MatImage::unsteg(const KeySchedule& ks, ostream& out)const
+		{
+			verify();
+			
+			Header h;
+			if(not header(h, ks))
+				{
+					if(not (out << reveal_legacy(ks)))
+						throw IOError(" Error ! Can't write the hidden text .... ");
+					return;
+				}
 				
-			// Decrypt and return the key
-			return reveal(key);
+			// A compressed or encrypted payload is decoded at once, an encrypted one is checked before it is written
+			if(h.flags & (Header::COMPRESSED | Header::ENCRYPTED))
+				{
+					string text = reveal(h, ks);
+					if(not out.write(text.data(), text.size()))
+						throw IOError(" Error ! Can't write the hidden text .... ");
+					return;
+				}
+				
+			// Read and write block by block
+			vector<byte> block(4*CHUNK);
+			for(uint64_t done = 0; done < h.length; )
+				{
+					size_t count = static_cast<size_t>(std::min<uint64_t>(block.size(), h.length - done));
+					get(block.data(), count, done, h, ks);
+					
+					if(not out.write(reinterpret_cast<const char *>(block.data()), count))
+						throw IOError(" Error ! Can't write the hidden text .... ");
+						
+					done += count;
+				}
 		}
 		
-	/** Respective definitions for 'private' helper methods. */
-	
-	// set_key() definition
-	void MatImage :: set_key(const string& key)
+	// Unsteg a range of the payload
+	string MatImage::unsteg_range(const string& key, uint64_t offset, uint64_t length)const
 		{
-			// Password should not be the empty
 			if(key.empty())
 				throw KeyEmptyError();
+				
+			return unsteg_range(KeySchedule(key), offset, length);
+		}
+		
+	string MatImage::unsteg_range(const KeySchedule& ks, uint64_t offset, uint64_t length)const
+		{
+			verify();
+			
+			Header h;
+			if(not header(h, ks))
+				{
+					// The older format has no length, so its text is read up to its end
+					string text = reveal_legacy(ks);
+					if(offset > text.size() or length > text.size() - offset)
+						throw RangeError();
+						
+					return text.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+				}
+				
+			// The bytes of a compressed or encrypted payload are only known (and checked) once all of it is decoded
+			if(h.flags & (Header::COMPRESSED | Header::ENCRYPTED))
+				{
+					string text = reveal(h, ks);
+					if(offset > text.size() or length > text.size() - offset)
+						throw RangeError();
+						
+					return text.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+				}
+				
+			if(offset > h.length or length > h.length - offset)
+				throw RangeError();
+				
+			string text(static_cast<size_t>(length), '\0');
+			if(length > 0)
+				get(reinterpret_cast<byte *>(&text[0]), text.size(), offset, h, ks);
+				
+			return (text);
+		}
+		
+	// Digest of the payload as it is stored
+	Digest MatImage::fingerprint(const KeySchedule& ks)const
+		{
+			verify();
+			
+			hashing::Context c;
+			c.start(hashing::SHA256);
+			
+			Header h;
+			if(not header(h, ks))
+				{
+					string text = reveal_legacy(ks);
+					c.update(text.data(), text.size());
+					return c.finish();
+				}
 			
-			// Now we store SHA-1 digest of key in the image and NOT the key in original form
-			string hash = sha(key);
-			assert(hash.size()==20);
+			byte bytes[Header::SIZE];
+			h.write(bytes);
+			c.update(bytes, Header::SIZE);
 			
-			// Key will be used to choose the store bits and ignore color
-			auto kit = key.begin();
+			// Block by block, only the rows up to the end of the payload are decoded
+			vector<byte> block(4*CHUNK);
+			for(uint64_t done = 0; done < h.length; )
+				{
+					size_t count = static_cast<size_t>(std::min<uint64_t>(block.size(), h.length - done));
+					get(block.data(), count, done, h, ks);
+					c.update(block.data(), count);
+					done += count;
+				}
+			
+			return c.finish();
+		} // 'fingerprint()' closed.
+		
+	/** Respective definitions for 'private' helper methods. */
+	
+	// Remember the pixels modified
+	void MatImage :: touch(long first, long last)
+		{
+			// Ranges are few (the key digest, then the payload written block by block), so they are merged as they come
+			for(pair<long, long>& t : mTouched)
+				if(first <= t.second and t.first <= last)
+					{
+						t.first = std::min(t.first, first);
+						t.second = std::max(t.second, last);
+						return;
+					}
+					
+			mTouched.push_back(make_pair(first, last));
+		} // 'touch()' closed.
+		
+	// Decode the rows not decoded yet
+	void MatImage :: decode(long rows) const
+		{
+			if(mReader)
+				mReader->decode(mMat.data, mMat.step, rows);
+		} // 'decode()' closed.
+	
+	/**
+	 * Every helper below hides or reads one byte in a group of 3 pixels (9 samples) using the kernels of
+	 * 'bitplane.h', or for the payload those of 'simd.h' over whole runs of groups. The key schedule 'ks' tells for
+	 * each byte which color is ignored and which plane stores each bit, the position 'k' in it simply restarts after
+	 * 'ks.period()' bytes. The colors are always counted in RGB order, the kernels map them to 'mOrder'.
+	 */
+	
+	// set_key() definition
+	void MatImage :: set_key(const KeySchedule& ks)
+		{
+			// Now we store the digest of key in the image and NOT the key in original form
+			// An encrypted text has random bytes instead, the salt of its header: a digest would check a guess with one hash
+			Digest hash;
+			if(mOptions.cipher != crypto::NONE)
+				crypto::random(hash.data(), hash.size());
+			else
+				hash = ks.digest(mOptions.digest);
+			
+			decode(rows());
+			touch(0, 3*static_cast<long>(hash.size()));
 			
 			// The will be written to the first row of the image in the form of hash
-			auto mit = mMat.begin<Vec3b>();
+			for_each_group(mMat, 0, hash.size(), true, [&](byte* s, size_t n, size_t run)
+				{
+					for(size_t k = ks.phase(n); run > 0; --run, ++n, s += 9)
+						{
+							const KeySchedule::Entry& e = ks[k];
+							if(++k == ks.period()) k = 0;
+							
+							if(mOrder == BGR)
+								bitplane::scatter<BGR>(s, hash[n], e.hignore, e.planes);
+							else
+								bitplane::scatter<RGB>(s, hash[n], e.hignore, e.planes);
+						}
+				});
+		} // 'set_key()' closed.
+		
+	// Hide bytes from the given group of the second row onwards
+	void MatImage :: embed(const byte* bytes, size_t count, size_t first, const KeySchedule& ks, unsigned shift)
+		{
+			decode(rows());
+			touch(cols() + 3*static_cast<long>(first), cols() + 3*static_cast<long>(first + count));
 			
-			// For every character or byte of image
-			for( auto hit = hash.begin(); hit != hash.end(); ++hit)
+			// Chunks are independent, each one starts at its own position in the key schedule
+			for_each_chunk(count, [&](size_t chunk, size_t len)
 				{
-					// Get the color to ignore
-					int ignore = static_cast<uint>(*(kit++))%8;
-					if(kit == key.end()) kit=key.begin();
+					for_each_group(mMat, cols() + 3*(first + chunk), len, true, [&](byte* s, size_t n, size_t run)
+						{
+							n += chunk;
+							simd::embed(s, bytes + n, run, ks, ks.phase(first + n), mOrder, shift);
+						});
+				});
+		} // 'embed()' closed.
+		
+	// Read bytes from the given group of the second row onwards
+	void MatImage :: extract(byte* bytes, size_t count, size_t first, const KeySchedule& ks, unsigned shift) const
+		{
+			// Only the rows up to the last group are needed
+			decode((cols() + 3*static_cast<long>(first + count) + cols() - 1) / cols());
+			
+			for_each_chunk(count, [&](size_t chunk, size_t len)
+				{
+					for_each_group(mMat, cols() + 3*(first + chunk), len, false, [&](byte* s, size_t n, size_t run)
+						{
+							n += chunk;
+							simd::extract(s, bytes + n, run, ks, ks.phase(first + n), mOrder, shift);
+						});
+				});
+		} // 'extract()' closed.
+		
+	/**
+	 * With 'bits' bits per sample, byte 'n' of the payload is in group 'n / bits' (after the header) in the planes
+	 * chosen by the key shifted by 'n % bits'. So the bytes of one shift are hidden in a run of groups, like with 1 bit
+	 * per sample, once gathered from every 'bits' bytes. It is done in slices to keep the buffer small.
+	 */
+	
+	// Hide payload bytes from the given offset
+	void MatImage :: put(const byte* data, size_t size, uint64_t offset, const Header& h, const KeySchedule& ks)
+		{
+			unsigned bits = h.depth;
+			
+			if(h.flags & Header::SCATTER)
+				{
+					scatter(data, size, offset, bits, ks);
+					return;
+				}
+				
+			if(bits == 1)
+				{
+					embed(data, size, Header::SIZE + offset, ks);
+					return;
+				}
+				
+			vector<byte> layer;
+			const size_t slice = bits * 4 * CHUNK;
+			
+			for(size_t done = 0; done < size; done += slice)
+				{
+					size_t count = std::min(slice, size - done);
+					uint64_t first = offset + done;
 					
-					// Set bits
-					uchar c = static_cast<uchar>(*hit);
-					int i=0, b=0;
+					for(unsigned shift = 0; shift < bits; ++shift)
+						{
+							// The first byte of the slice with this shift, then every 'bits' bytes
+							uint64_t n = first + (shift + bits - first % bits) % bits;
+							if(n >= first + count)
+								continue;
+								
+							size_t groups = static_cast<size_t>((first + count - n + bits - 1) / bits);
+							layer.resize(groups);
+							for(size_t g = 0; g < groups; ++g)
+								layer[g] = data[n - offset + g*bits];
+								
+							embed(layer.data(), groups, Header::SIZE + n / bits, ks, shift);
+						}
+				}
+		} // 'put()' closed.
+		
+	// Read payload bytes from the given offset
+	void MatImage :: get(byte* data, size_t size, uint64_t offset, const Header& h, const KeySchedule& ks) const
+		{
+			unsigned bits = h.depth;
+			
+			if(h.flags & Header::SCATTER)
+				{
+					gather(data, size, offset, bits, ks);
+					return;
+				}
+				
+			if(bits == 1)
+				{
+					extract(data, size, Header::SIZE + offset, ks);
+					return;
+				}
+				
+			vector<byte> layer;
+			const size_t slice = bits * 4 * CHUNK;
+			
+			for(size_t done = 0; done < size; done += slice)
+				{
+					size_t count = std::min(slice, size - done);
+					uint64_t first = offset + done;
 					
-					// 3 pixels for each byte
-					for( int px = 0 ; px < 3 ; ++px, ++mit)
+					for(unsigned shift = 0; shift < bits; ++shift)
 						{
-							// 3 colors for each pixel
-							for( int color = 0; color < 3; ++color, ++i)
+							uint64_t n = first + (shift + bits - first % bits) % bits;
+							if(n >= first + count)
+								continue;
+								
+							size_t groups = static_cast<size_t>((first + count - n + bits - 1) / bits);
+							layer.resize(groups);
+							extract(layer.data(), groups, Header::SIZE + n / bits, ks, shift);
+							
+							for(size_t g = 0; g < groups; ++g)
+								data[n - offset + g*bits] = layer[g];
+						}
+				}
+		} // 'get()' closed.
+		
+	/**
+	 * A scattered payload is hidden in the same way except for the place of its groups: group 'u' of the payload is
+	 * group 'p(u)' after the header, 'p' being the permutation of the key, and its choices are those of the key at
+	 * that place. Groups are independent, so they are split among the threads evenly whatever the range.
+	 */
+	
+	// Hide payload bytes spread over the image
+	void MatImage :: scatter(const byte* data, size_t size, uint64_t offset, unsigned bits, const KeySchedule& ks)
+		{
+			long groups = max(1);
+			
+			decode(rows());
+			touch(cols() + 3*static_cast<long>(Header::SIZE), cols() + 3*(static_cast<long>(Header::SIZE) + groups));
+			
+			Permutation p(ks.key(), static_cast<uint64_t>(groups));
+			uint64_t first = offset / bits, last = (offset + size + bits - 1) / bits;
+			
+			for_each_chunk(static_cast<size_t>(last - first), [&](size_t chunk, size_t len)
+				{
+					for(uint64_t u = first + chunk; u < first + chunk + len; ++u)
+						{
+							size_t g = Header::SIZE + static_cast<size_t>(p(u));
+							const KeySchedule::Entry& e = ks[ks.phase(g)];
+							
+							for_each_group(mMat, cols() + 3*g, 1, true, [&](byte* s, size_t, size_t)
 								{
-									// Don't use the ignore color
-									if(i != ignore)
+									// The bytes of the group that are in the range, one per shift
+									for(unsigned shift = 0; shift < bits; ++shift)
 										{
-											// Get the store bit
-											int s = static_cast<int>(*(kit++))%2;
-											if(kit == key.end()) kit = key.begin();
-											
-											// Now store the bit 
-											setbit( (*mit)[color], getbit(c, b++), s);
+											uint64_t n = u*bits + shift;
+											if(n < offset or n >= offset + size)
+												continue;
+												
+											if(mOrder == BGR)
+												bitplane::scatter<BGR>(s, data[n - offset], e.ignore, e.planes, shift);
+											else
+												bitplane::scatter<RGB>(s, data[n - offset], e.ignore, e.planes, shift);
 										}
-								} // 'for( int color = 0; color < 3; ++color, ++i)' closed.
-								
-						} // 'for( int px = 0 ; px < 3 ; ++px, ++mit)' closed.
-						
-				} // 'for( auto hit = hash.begin(); hit != hash.end(); ++hit)' closed.
-				
-		} // 'set_key()' closed.
+								});
+						}
+				});
+		} // 'scatter()' closed.
 		
-	// conceal() definition
-	void MatImage :: conceal(const string& text, const string& key)
+	// Read payload bytes spread over the image
+	void MatImage :: gather(byte* data, size_t size, uint64_t offset, unsigned bits, const KeySchedule& ks) const
 		{
-			// Check for pre-conditions
-			if(text.empty())
-				throw TextEmptyError();
-			if(key.empty())
-				throw KeyEmptyError();
-				
-			// If all ok, then start writing the text from the second row of the image
-			auto mit = mMat.begin<Vec3b>() + cols();
+			long groups = max(1);
 			
-			// Add '\0' to the end of the text for indication while decrypting later
-			auto txt = text;
-			txt.push_back(0);
+			decode(rows());
 			
-			// The key will be used to choose store the bits and ignore color
-			auto kit = key.begin();
+			Permutation p(ks.key(), static_cast<uint64_t>(groups));
+			uint64_t first = offset / bits, last = (offset + size + bits - 1) / bits;
 			
-			// For each character or byte of the text
-			for( auto tit = txt.begin() ; tit != txt.end() ; ++tit)
+			for_each_chunk(static_cast<size_t>(last - first), [&](size_t chunk, size_t len)
 				{
-					// Get the ignore bit
-					int ignore = static_cast<uint>(*(kit++))%9;
-					if(kit == key.end()) kit=key.begin();
-					
-					// Set the bits
-					uchar c = static_cast<uchar>(*tit);
-					int i=0, b=0;
-					
-					// 3 pixels for each byte
-					for(int px=0; px<3; ++px, ++mit)
+					for(uint64_t u = first + chunk; u < first + chunk + len; ++u)
 						{
-							// 3 colors for each pixel
-							for(int color=0; color<3 ; ++color, ++i)
+							size_t g = Header::SIZE + static_cast<size_t>(p(u));
+							const KeySchedule::Entry& e = ks[ks.phase(g)];
+							
+							for_each_group(mMat, cols() + 3*g, 1, false, [&](byte* s, size_t, size_t)
 								{
-									// Don't use the ignore color
-									if(i!=ignore)
+									for(unsigned shift = 0; shift < bits; ++shift)
 										{
-											// Get the store bit
-											int s = static_cast<uint>(*(kit++))%2;
-											if(kit==key.end()) kit=key.begin();
-											
-											// Store the bit
-											setbit( (*mit)[color], getbit(c, b++), s);
+											uint64_t n = u*bits + shift;
+											if(n < offset or n >= offset + size)
+												continue;
+												
+											data[n - offset] = (mOrder == BGR) ? bitplane::gather<BGR>(s, e.ignore, e.planes, shift)
+																			   : bitplane::gather<RGB>(s, e.ignore, e.planes, shift);
 										}
-								}
+								});
 						}
+				});
+		} // 'gather()' closed.
+		
+	// Check the image before reading anything, the key is checked by 'header()'
+	void MatImage :: verify() const
+		{
+			if(empty())
+				throw ImageEmptyError();
+				
+			if(cols() < 80)
+				throw InsufficientImageError(" The image is not stego ");
+		} // 'verify()' closed.
+		
+	// Whether the key finds a text
+	bool MatImage :: keyed(const KeySchedule& ks) const
+		{
+			Header h;
+			try
+				{
+					header(h, ks);
+				}
+			catch(const KeyMismatchError&)
+				{
+					return false;
+				}
+			catch(const Error&)
+				{
+					// The key matches, the header is one this version can't read
+				}
+				
+			return true;
+		} // 'keyed()' closed.
+		
+	// Check the capacity
+	void MatImage :: check(size_t size, size_t overhead) const
+		{
+			if(empty())
+				throw ImageEmptyError();
+				
+			if(size == 0)
+				throw TextEmptyError();
+				
+			if(cols() < 80)
+				throw InsufficientImageError(" Size error :Image is of too small size ! ");
+			
+			if(size + overhead > static_cast<size_t>(max()))
+				throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+		} // 'check()' closed.
+		
+	// conceal() definition
+	void MatImage :: conceal(const byte* data, size_t size, bool compressed, const KeySchedule& ks)
+		{
+			// Start writing from the second row of the image, first the header then the payload
+			Header h(size, mOptions.depth, mOptions.scatter);
+			h.digest = static_cast<uint8_t>(mOptions.digest);
+			if(compressed)
+				h.flags |= Header::COMPRESSED;
+			if(mOptions.cipher != crypto::NONE)
+				{
+					h.flags |= Header::ENCRYPTED;
+					h.length += crypto::Envelope::SIZE;
 				}
+				
+			byte header[Header::SIZE];
+			h.write(header);
+			
+			// The header of an encrypted payload is masked with a key derived from the password, see 'header()'
+			if(mOptions.cipher != crypto::NONE)
+				crypto::mask(ks.key(), hash(ks).data(), header);
+				
+			embed(header, Header::SIZE, 0, ks);
+			
+			if(mOptions.cipher != crypto::NONE)
+				seal(data, size, h, ks);
+			else
+				put(data, size, 0, h, ks);
 		} // 'conceal()' closed.
 		
+	/**
+	 * An encrypted payload is its envelope followed by the ciphertext. Every chunk is encrypted (or decrypted) just
+	 * before it is hidden (or just after it is read), so it is still in the cache: it costs a single more pass.
+	 */
+	
+	// Encrypt and hide the payload
+	void MatImage :: seal(const byte* data, size_t size, const Header& h, const KeySchedule& ks)
+		{
+			crypto::Envelope e;
+			e.algorithm = mOptions.cipher;
+			e.iterations = mOptions.iterations;
+			crypto::Cipher c(crypto::Cipher::ENCRYPT, ks.key(), e, h);
+			
+			vector<byte> block(std::min(size, 4*CHUNK));
+			for(size_t done = 0; done < size; done += block.size())
+				{
+					block.resize(std::min(block.size(), size - done));
+					c.update(data + done, block.data(), block.size());
+					put(block.data(), block.size(), crypto::Envelope::SIZE + done, h, ks);
+				}
+				
+			byte envelope[crypto::Envelope::SIZE];
+			c.finish(e);
+			e.write(envelope);
+			put(envelope, crypto::Envelope::SIZE, 0, h, ks);
+		} // 'seal()' closed.
+		
+	// Read and decrypt the payload
+	string MatImage :: unseal(const Header& h, const KeySchedule& ks) const
+		{
+			if(h.length < crypto::Envelope::SIZE)
+				throw Error(" The image is not stego or it is corrupted ! ");
+				
+			byte envelope[crypto::Envelope::SIZE];
+			get(envelope, crypto::Envelope::SIZE, 0, h, ks);
+			
+			crypto::Envelope e;
+			e.read(envelope);
+			crypto::Cipher c(crypto::Cipher::DECRYPT, ks.key(), e, h);
+			
+			string text(static_cast<size_t>(h.length) - crypto::Envelope::SIZE, '\0');
+			byte * bytes = reinterpret_cast<byte *>(&text[0]);
+			
+			for(size_t done = 0; done < text.size(); )
+				{
+					size_t count = std::min(4*CHUNK, text.size() - done);
+					get(bytes + done, count, crypto::Envelope::SIZE + done, h, ks);
+					c.update(bytes + done, bytes + done, count);
+					done += count;
+				}
+				
+			// Nothing is returned unless the tag matches
+			c.finish(e);
+			
+			return (text);
+		} // 'unseal()' closed.
+		
+	// Read the header
+	bool MatImage :: header(Header& h, const KeySchedule& ks) const
+		{
+			// The header is hidden with the key schedule only, so it is read first to know the algorithm of the digest
+			byte bytes[Header::SIZE];
+			extract(bytes, Header::SIZE, 0, ks);
+			Digest row = hash(ks);
+			
+			// A text in clear has the digest of the key in the first row, compared in constant time. A wrong key reads
+			// garbage, which is compared as SHA-1 (the older format has no header) and doesn't match
+			bool found = false;
+			try
+				{
+					if(not h.read(bytes))
+						{
+							if(same(ks.digest(hashing::SHA1), row))
+								return false;
+						}
+					else
+						found = not (h.flags & Header::ENCRYPTED)
+								and same(ks.digest(static_cast<hashing::Algorithm>(h.digest)), row);
+				}
+			catch(const Error&)
+				{
+					// A header of the key, of a version or with options this one doesn't know
+					if(same(ks.digest(hashing::SHA1), row))
+						throw;
+				}
+				
+			/**
+			 * Else it may be the header of an encrypted text, masked with the key derived from the password and the salt
+			 * in the first row ('crypto::mask()'). A wrong password reads garbage there too, so it is only told once
+			 * the key is derived, and any other key costs as much to reject.
+			 */
+			if(not found)
+				{
+					crypto::mask(ks.key(), row.data(), bytes);
+					try
+						{
+							found = h.read(bytes) and (h.flags & Header::ENCRYPTED);
+						}
+					catch(const Error&)
+						{
+						}
+						
+					if(not found)
+						throw KeyMismatchError();
+				}
+				
+			// The length must fit in the image
+			if(h.length > static_cast<uint64_t>(max(h.depth)))
+				throw Error(" The image is not stego or it is corrupted ! ");
+				
+			return true;
+		} // 'header()' closed.
+		
 	// Reveal the text hidden
-	string MatImage::reveal(const string& key)const
+	string MatImage::reveal(const Header& h, const KeySchedule& ks)const
+		{
+			// The length is known, so read the text in one bounded pass
+			string text;
+			if(h.flags & Header::ENCRYPTED)
+				text = unseal(h, ks);
+			else
+				{
+					text.resize(h.length);
+					get(reinterpret_cast<byte *>(&text[0]), text.size(), 0, h, ks);
+				}
+				
+
+			if(h.flags & Header::COMPRESSED)
+				return compression::decompress(reinterpret_cast<const byte *>(text.data()), text.size());
+				
+			return (text);
+		} // 'reveal()' closed.
+		
+	// Reveal the text hidden in the older format i.e. with no header and followed by '\0'
+	string MatImage::reveal_legacy(const KeySchedule& ks)const
 		{
 			string text;
 			
-			// Key will be used to store the bits and the ignore color
-			auto kit = key.begin();
+			/**
+			 * Read windows of bytes from the second row, every window in parallel chunks, until one of them has the
+			 * '\0'. Each chunk finds its own first '\0' and the smallest one is the end of the text. Windows double
+			 * in size so short texts stay cheap, and they never go beyond the image.
+			 */
+			size_t capacity = static_cast<size_t>(cols()*(rows()-1)/3);
+			size_t window = CHUNK * getNumThreads();
 			
-			// Start iterating the pixels from the second row
-			for( auto mit = mMat.begin<Vec3b>()+cols() ; ; )
+			for(size_t start = 0; start < capacity; start += window, window *= 2)
 				{
-					// Get the ignore color 
-					int ignore = static_cast<uint>(*(kit++))%9;
-					if(kit == key.end()) kit = key.begin();
+					size_t count = std::min(window, capacity - start);
+					text.resize(start + count);
+					byte * bytes = reinterpret_cast<byte *>(&text[start]);
 					
-					// Set the bits
-					uchar c;
-					int b=0, i=0;
+					vector<size_t> ends((count + CHUNK - 1) / CHUNK, string::npos);
 					
-					// 3 pixels for each byte
-					for(int px=0; px<3; ++px, ++mit)
+					// Decode the rows of the window before reading it in parallel
+					decode((cols() + 3*static_cast<long>(start + count) + cols() - 1) / cols());
+					
+					for_each_chunk(count, [&](size_t chunk, size_t len)
 						{
-							// 3 colors for each pixels
-							for(int color=0; color<3; ++color, ++i)
-								{
-									// Don't use the ignore color
-									if(i != ignore)
-										{
-											// Get the store bit
-											int s = static_cast<uint>(*(kit++))%2;
-											if(kit == key.end()) kit=key.begin();
-											
-											// Get the bit from the color
-											setbit( c, getbit((*mit)[color], s), b++);
-										}
-								}
+							extract(bytes + chunk, len, start + chunk, ks);
+							
+							const void * end = std::memchr(bytes + chunk, 0, len);
+							if(end)
+								ends[chunk / CHUNK] = start + (static_cast<const byte *>(end) - bytes);
+						});
+					
+					// Check whether the end of the text is in this window
+					size_t end = *std::min_element(ends.begin(), ends.end());
+					if(end != string::npos)
+						{
+							text.resize(end);
+							return (text);
 						}
-					// After getting each byte, check first whether it is the end of the text
-					if( c == 0 ) break;
-					text.push_back(c);
 				}
-			return (text);
-		} // 'reveal()' closed.
+				
+			throw Error(" The end of the hidden text is not found ! ");
+		} // 'reveal_legacy()' closed.
 		
 	// Get the hash string of the key
-	string MatImage::hash(const string& key) const
+	Digest MatImage::hash(const KeySchedule& ks) const
 		{
-    		string hash;
-
-    		// Key will be used to choose store bits and ignore color
-		    auto kit = key.begin();
-
-		    // Start iterating the pixels from 1st row
-		    auto mit = mMat.begin<Vec3b>();
-		    
-	        // The hash is 20 bytes long
-	        for (int size = 0; size < 20; ++size)
-	        	{
-			        // Get the ignore color
-			        int ignore = static_cast<uint>(*(kit++)) % 8;
-			        if (kit == key.end()) kit = key.begin();
-
-			        // Set bits
-        			uchar c;
-			        int b = 0, i = 0;
-
-			        // 3 pixels for each byte
-			        for (int px = 0; px < 3; ++px, ++mit)
-			        	{
-				            // 3 colors for each pixel
-				            for (int color = 0; color < 3; ++color, ++i)
-				            	{
-					                // Don't use the ignore color
-					                if (i != ignore) 
-					                	{
-						                    // Get the store bit
-						                    int s = static_cast<uint>(*(kit++)) % 2;
-						                    if (kit == key.end()) kit = key.begin();
-
-						                    // Get the bit from the color
-						                    setbit(c, getbit((*mit)[color], s), b++);
-						                }	// 'if (i != ignore)' closed.
-
-					            }	// 'for (int color = 0; color < 3; ++color, ++i)' closed.
-
-				        }	// 'for (int px = 0; px < 3; ++px, ++mit)' closed.
-
-			        hash.push_back(c);
-    			}	// 'for (int size = 0; size < 20; ++size)' closed.
-
- 		   return (hash);    
+			// The hash is 20 bytes long, in the 1st row
+			Digest hash;
+			
+			decode((3*static_cast<long>(hash.size()) + cols() - 1) / cols());
+			
+			for_each_group(mMat, 0, hash.size(), false, [&](byte* s, size_t n, size_t run)
+				{
+					for(size_t k = ks.phase(n); run > 0; --run, ++n, s += 9)
+						{
+							const KeySchedule::Entry& e = ks[k];
+							if(++k == ks.period()) k = 0;
+							
+							hash[n] = (mOrder == BGR) ? bitplane::gather<BGR>(s, e.hignore, e.planes)
+													  : bitplane::gather<RGB>(s, e.hignore, e.planes);
+						}
+				});
+				
+			return (hash);
 		} // 'hash()' closed.
 
 } // namespace 'Steganography' closed.
@@ -0,0 +1,100 @@
+/**
+ * This file contains the definitions of 'Permutation' class
+ * Declaration is in 'Permutation.h'
+ */
+
+#include "Permutation.h"
+#include "util.h"
+
+using namespace std;
+
+namespace
+{
+	// Mixes the bits of a 64-bit word (the finalizer of SplitMix64)
+	uint64_t mix(uint64_t x)
+		{
+			x ^= x >> 30;
+			x *= 0xbf58476d1ce4e5b9ULL;
+			x ^= x >> 27;
+			x *= 0x94d049bb133111ebULL;
+			x ^= x >> 31;
+			return x;
+		}
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Derive the round keys
+	Permutation::Permutation(const string& key, uint64_t size) : mSize(size), mHalf(1)
+		{
+			// The smallest even number of bits covering the range
+			while(mHalf < 32 and (uint64_t(1) << (2*mHalf)) < size)
+				++mHalf;
+
+			mMask = (uint64_t(1) << mHalf) - 1;
+
+			Digest d = sha1("permutation:" + key);
+			uint64_t seed = 0;
+			for(int i = 0; i < 8; ++i)
+				seed |= static_cast<uint64_t>(d[i]) << (8*i);
+
+			for(int r = 0; r < ROUNDS; ++r)
+				mKeys[r] = mix(seed + (r + 1) * 0x9e3779b97f4a7c15ULL);
+		}
+
+	// Return the size
+	uint64_t Permutation::size() const
+		{
+			return mSize;
+		}
+
+	// One pass of the network
+	uint64_t Permutation::encrypt(uint64_t x) const
+		{
+			uint64_t left = x >> mHalf, right = x & mMask;
+
+			for(int r = 0; r < ROUNDS; ++r)
+				{
+					uint64_t next = left ^ (mix(right ^ mKeys[r]) & mMask);
+					left = right;
+					right = next;
+				}
+
+			return (left << mHalf) | right;
+		}
+
+	uint64_t Permutation::decrypt(uint64_t x) const
+		{
+			uint64_t left = x >> mHalf, right = x & mMask;
+
+			for(int r = ROUNDS - 1; r >= 0; --r)
+				{
+					uint64_t prev = right ^ (mix(left ^ mKeys[r]) & mMask);
+					right = left;
+					left = prev;
+				}
+
+			return (left << mHalf) | right;
+		}
+
+	// Map a value, walking the cycle until it falls in the range
+	uint64_t Permutation::operator()(uint64_t i) const
+		{
+			do
+				i = encrypt(i);
+			while(i >= mSize);
+
+			return i;
+		}
+
+	uint64_t Permutation::inverse(uint64_t i) const
+		{
+			do
+				i = decrypt(i);
+			while(i >= mSize);
+
+			return i;
+		}
+
+} // namespace 'Steganography' closed.
@@ -0,0 +1,399 @@
+/**
+ * This file contains the definitions of 'Pipeline' class
+ * Declaration is in 'Pipeline.h'
+ */
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <exception>
+#include <algorithm>
+#include <sys/stat.h>
+#include "Pipeline.h"
+#include "RowWriter.h"
+#include "BoundedQueue.h"
+#include "Header.h"
+#include "bitplane.h"
+#include "simd.h"
+#include "Compression.h"
+#include "Cipher.h"
+#include "Hash.h"
+#include "Error.h"
+
+using namespace std;
+
+using byte = uint8_t;
+using Clock = chrono::steady_clock;
+
+namespace
+{
+	using namespace Steganography;
+
+	/** Rows of the image in flight, from row 'first' */
+	struct Band
+		{
+			long first = 0;
+			int count = 0;
+			vector<byte> pixels;
+		};
+
+	/**
+	 * Hides the header and the payload in groups of 3 pixels, laid out as 'MatImage::put()' does: group 'g' (after the
+	 * first row) holds byte 'g' of the header, then with 'depth' bits per sample byte 'n' of the payload is in group
+	 * 'Header::SIZE + n / depth' in the planes shifted by 'n % depth'.
+	 */
+	class Layout
+		{
+			private :
+				const byte* mHeader;
+				const byte* mPayload;
+				size_t mLength;
+				unsigned mDepth;
+				const KeySchedule& mKs;
+				ChannelOrder mOrder;
+				vector<byte> mLayer;
+
+			public :
+				Layout(const byte* header, const byte* payload, size_t length, unsigned depth, const KeySchedule& ks,
+					   ChannelOrder order) :
+					mHeader(header), mPayload(payload), mLength(length), mDepth(depth), mKs(ks), mOrder(order)
+					{
+					}
+
+				// Number of groups of the header and the payload
+				size_t groups() const
+					{
+						return Header::SIZE + (mLength + mDepth - 1) / mDepth;
+					}
+
+				// Hides groups 'g' to 'g + count' (excluded), lying contiguously from 's'
+				void hide(byte* s, size_t g, size_t count)
+					{
+						if(g < Header::SIZE and count > 0)
+							{
+								size_t n = std::min(count, Header::SIZE - g);
+								simd::embed(s, mHeader + g, n, mKs, mKs.phase(g), mOrder);
+								s += 9*n;
+								g += n;
+								count -= n;
+							}
+
+						if(count == 0)
+							return;
+
+						size_t u = g - Header::SIZE;
+						if(mDepth == 1)
+							{
+								simd::embed(s, mPayload + u, count, mKs, mKs.phase(g), mOrder);
+								return;
+							}
+
+						// The bytes of one shift, the last group may miss some
+						for(unsigned shift = 0; shift < mDepth; ++shift)
+							{
+								size_t end = (mLength - shift + mDepth - 1) / mDepth;
+								if(end <= u)
+									continue;
+
+								size_t n = std::min(count, end - u);
+								mLayer.resize(n);
+								for(size_t i = 0; i < n; ++i)
+									mLayer[i] = mPayload[(u + i)*mDepth + shift];
+
+								simd::embed(s, mLayer.data(), n, mKs, mKs.phase(g), mOrder, shift);
+							}
+					}
+		};
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Constructor
+	Pipeline::Pipeline(const shared_ptr<RowReader>& reader, const string& filename, const PngSettings& png)
+			: mReader(reader), mFilename(filename), mPng(png)
+		{
+		}
+
+	// Open an image that can be streamed
+	shared_ptr<Pipeline> Pipeline::open(const string& image, const string& stego, const PngSettings& png)
+		{
+			if(not RowWriter::supported(stego))
+				return nullptr;
+
+			// Writing the stego-image must not overwrite the image being read
+			struct stat in, out;
+			if(stat(image.c_str(), &in) == 0 and stat(stego.c_str(), &out) == 0
+					and in.st_dev == out.st_dev and in.st_ino == out.st_ino)
+				return nullptr;
+
+			shared_ptr<RowReader> reader = RowReader::open(image);
+			if(not reader)
+				return nullptr;
+
+			return shared_ptr<Pipeline>(new Pipeline(reader, stego, png));
+		}
+
+	// Hide the bytes while streaming the image
+	StegReport Pipeline::run(const byte* data, size_t size, const KeySchedule& ks, const StegOptions& options)
+		{
+			if(not mReader)
+				throw Error(" The pipeline was already run ! ");
+
+			if(options.depth < 1 or options.depth > 4)
+				throw Error(" The number of bits per sample should be from 1 to 4 ! ");
+
+			if(options.scatter)
+				throw Error(" A text streamed with the image can't be scattered, it needs the whole image ! ");
+
+			Clock::time_point start = Clock::now();
+			StegReport report = StegReport();
+			report.raw = size;
+
+			if(size == 0)
+				throw TextEmptyError();
+
+			Header h(0, static_cast<uint8_t>(options.depth));
+			h.digest = static_cast<uint8_t>(options.digest);
+
+			// Compress the text, as 'MatImage::steg()' does
+			vector<byte> packed;
+			if(options.codec != compression::NONE)
+				{
+					packed = compression::compress(options.codec, options.level, data, size);
+					if(packed.size() < size)
+						{
+							data = packed.data();
+							size = packed.size();
+							h.flags |= Header::COMPRESSED;
+						}
+					else
+						packed.clear();
+				}
+
+			Clock::time_point compressed = Clock::now();
+			report.compress = chrono::duration<double>(compressed - start).count();
+
+			// Check the capacity before creating anything
+			size_t prefix = (options.cipher != crypto::NONE) ? crypto::Envelope::SIZE : 0;
+			long cols = mReader->cols(), rows = mReader->rows();
+			long groups = (cols*(rows-1))/3 - static_cast<long>(Header::SIZE);
+
+			if(cols < 80)
+				throw InsufficientImageError(" Size error :Image is of too small size ! ");
+
+			if(groups <= 0 or prefix + size > static_cast<size_t>(groups) * options.depth)
+				throw InsufficientImageError(" Insufficient image capacity error : The text to be hidden is large than the image ! ");
+
+			// Encrypt it after its envelope
+			vector<byte> sealed;
+			if(prefix)
+				{
+					crypto::Envelope e;
+					e.algorithm = options.cipher;
+					e.iterations = options.iterations;
+					h.flags |= Header::ENCRYPTED;
+					crypto::Cipher c(crypto::Cipher::ENCRYPT, ks.key(), e, h);
+
+					sealed.resize(prefix + size);
+					c.update(data, sealed.data() + prefix, size);
+					c.finish(e);
+					e.write(sealed.data());
+
+					data = sealed.data();
+					size = sealed.size();
+				}
+
+			h.length = size;
+			report.stored = size;
+
+			byte header[Header::SIZE];
+			h.write(header);
+
+			hashing::Context c;
+			c.start(hashing::SHA256);
+			c.update(header, Header::SIZE);
+			c.update(data, size);
+			mFingerprint = c.finish();
+
+			// A random salt for an encrypted text, and its header masked, as 'MatImage::set_key()' and 'conceal()'
+			Digest hash;
+			if(prefix)
+				{
+					crypto::random(hash.data(), hash.size());
+					crypto::mask(ks.key(), hash.data(), header);
+				}
+			else
+				hash = ks.digest(options.digest);
+			Layout layout(header, data, size, options.depth, ks, mReader->order());
+			size_t total = layout.groups();
+
+			// The stages, the first error closes every queue so that the others stop
+			shared_ptr<RowReader> reader = mReader;
+			mReader.reset();
+			shared_ptr<RowWriter> writer = RowWriter::open(mFilename, static_cast<int>(cols), static_cast<int>(rows),
+														   reader->order(), mPng);
+			if(not writer)
+				throw IOError(" Error ! Can't write the image file .... ");
+
+			const size_t step = 3*static_cast<size_t>(cols);
+			BoundedQueue<vector<byte> > pool(BANDS);
+			BoundedQueue<Band> decoded(BANDS), hidden(BANDS);
+
+			for(size_t b = 0; b < BANDS; ++b)
+				pool.push(vector<byte>(step * BAND));
+
+			exception_ptr error;
+			mutex errorMutex;
+			auto fail = [&](exception_ptr e)
+				{
+					{
+						lock_guard<mutex> lock(errorMutex);
+						if(not error)
+							error = e;
+					}
+					pool.close();
+					decoded.close();
+					hidden.close();
+				};
+
+			auto failed = [&]()
+				{
+					lock_guard<mutex> lock(errorMutex);
+					return static_cast<bool>(error);
+				};
+
+			thread decoder([&]()
+				{
+					try
+						{
+							for(long first = 0; first < rows; )
+								{
+									Band band;
+									if(not pool.pop(band.pixels))
+										return;
+
+									band.first = first;
+									band.count = reader->next(band.pixels.data(), step, BAND);
+									if(band.count == 0)
+										throw IOError(" Error ! Can't decode the image file .... ");
+
+									first += band.count;
+									if(not decoded.push(std::move(band)))
+										return;
+								}
+
+							decoded.close();
+						}
+					catch(...)
+						{
+							fail(current_exception());
+						}
+				});
+
+			thread encoder([&]()
+				{
+					try
+						{
+							Band band;
+							while(hidden.pop(band))
+								{
+									writer->encode(band.pixels.data(), step, band.count);
+									pool.push(std::move(band.pixels));
+								}
+
+							// A stage that failed closed the queue early, the file is then incomplete
+							if(not failed())
+								writer.reset();
+						}
+					catch(...)
+						{
+							fail(current_exception());
+						}
+				});
+
+			// Hide the groups of every band, those crossing into it from the band before are done with it
+			try
+				{
+					Band previous, band;
+					bool first = true;
+
+					while(decoded.pop(band))
+						{
+							byte * s = band.pixels.data();
+							long p0 = band.first * cols, p1 = (band.first + band.count) * cols;
+
+							// The digest of the key in the first row, like 'MatImage::set_key()'
+							if(band.first == 0)
+								for(size_t n = 0; n < hash.size(); ++n)
+									{
+										const KeySchedule::Entry& e = ks[ks.phase(n)];
+										if(reader->order() == BGR)
+											bitplane::scatter<BGR>(s + 9*n, hash[n], e.hignore, e.planes);
+										else
+											bitplane::scatter<RGB>(s + 9*n, hash[n], e.hignore, e.planes);
+									}
+
+							// The group crossing from the band before, its pixels are copied to a local buffer
+							long o0 = p0 - cols, o1 = p1 - cols;
+							if(o0 > 0 and o0 % 3 != 0 and static_cast<size_t>(o0 / 3) < total)
+								{
+									size_t g = static_cast<size_t>(o0 / 3);
+									size_t before = 3*static_cast<size_t>(p0 - (cols + 3*static_cast<long>(g)));
+									byte tmp[9];
+
+									std::memcpy(tmp, previous.pixels.data() + step * previous.count - before, before);
+									std::memcpy(tmp + before, s, 9 - before);
+									layout.hide(tmp, g, 1);
+									std::memcpy(previous.pixels.data() + step * previous.count - before, tmp, before);
+									std::memcpy(s, tmp + before, 9 - before);
+								}
+
+							// The groups lying completely in the band
+							size_t g0 = (o0 > 0) ? static_cast<size_t>((o0 + 2) / 3) : 0;
+							size_t g1 = (o1 > 0) ? std::min(static_cast<size_t>(o1 / 3), total) : 0;
+							if(g0 < g1)
+								layout.hide(s + 3*(cols + 3*static_cast<long>(g0) - p0), g0, g1 - g0);
+
+							if(not first and not hidden.push(std::move(previous)))
+								break;
+
+							previous = std::move(band);
+							first = false;
+						}
+
+					if(not first and not failed())
+						hidden.push(std::move(previous));
+
+					hidden.close();
+				}
+			catch(...)
+				{
+					fail(current_exception());
+				}
+
+			decoder.join();
+			encoder.join();
+
+			if(error)
+				{
+					writer.reset();
+					std::remove(mFilename.c_str());
+					rethrow_exception(error);
+				}
+
+			report.embed = chrono::duration<double>(Clock::now() - compressed).count();
+
+			return report;
+		}
+
+	// Digest of what was hidden
+	const Digest& Pipeline::fingerprint() const
+		{
+			return mFingerprint;
+		}
+
+}	// namespace 'Steganography' closed.
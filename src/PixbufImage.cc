@@ -0,0 +1,155 @@
+/**
+ * This file contains the definitions of 'PixbufImage' class
+ * Declaration is in 'PixbufImage.h'
+ */
+ 
+#include <stdexcept>
+#include <utility>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include "PixbufImage.h"
+
+using namespace cv;
+using namespace std;
+using Glib::RefPtr;
+using Gdk::Pixbuf;
+
+namespace Steganography
+{
+	// Open an image file
+	PixbufImage::PixbufImage(const string& filename) : MatImage(filename)
+		{
+		}
+		
+	// Create from 'Gdk::Pixbuf'
+	PixbufImage::PixbufImage(const Glib::RefPtr<Gdk::Pixbuf>& p)
+		{
+			// Copy the 'Gdk::Pixbuf', it is kept as long as the image since it owns the pixels
+			mPixbuf = p->copy();
+			RefPtr<Pixbuf> pp = mPixbuf;
+			
+			// Then convert into 'cv::mMat'
+			mMat = Mat(
+						Size(pp->get_width(), pp->get_height()),		// Dimensions
+						CV_8UC3,										// Type
+						pp->get_pixels(),								// Pointer to the data
+						pp->get_rowstride()								// Bytes per row
+					  );
+					
+			/**
+			 * Any primitive type from the list can be defined by an identifier in the form 
+			 * 'CV_<bit-depth>{U|S|F}C(<number_of_channels>)'
+			 * where U is unsigned integer type, S is signed integer type, and F is float type, C means channels.
+			 * so CV_8UC3 is an 8-bit unsigned integer matrix/image with 3 channels. 
+			 * Although it is most common that this means an RGB (or actually BGR) image, it does not mandate it. 
+			 * It simply means that there are three channels, and how you use them is up to you and your application. 
+			 */
+		}
+		
+	// Create from a 'MatImage'
+	PixbufImage::PixbufImage(MatImage&& image) : MatImage(std::move(image))
+		{
+		}
+		
+	// Destructor
+	PixbufImage::~PixbufImage()
+		{
+			// Nothing to do since all clean up will be done automatically
+		}
+		
+	// Converts the image to 'Gdk::Pixbuf' object
+	RefPtr<Pixbuf> PixbufImage::pixbuf() const
+		{
+			// GTK needs RGB, an image loaded as BGR is converted into the pixels of a new 'Gdk::Pixbuf', the image
+			// itself stays as it is
+			decode(rows());
+			if(order() == BGR)
+				{
+					RefPtr<Pixbuf> p = Pixbuf::create(Gdk::COLORSPACE_RGB, false, 8, mMat.cols, mMat.rows);
+					Mat rgb(mMat.rows, mMat.cols, CV_8UC3, p->get_pixels(), p->get_rowstride());
+					cvtColor(mMat, rgb, CV_BGR2RGB);
+					return p;
+				}
+				
+			return Gdk::Pixbuf::create_from_data(
+													mMat.data,				// Pointer to the pixels array
+													Gdk::COLORSPACE_RGB,	// Colorspace RGB only
+													false,					// Transparancy ?
+													8,						// Bits per sample always 8
+													mMat.cols,				// Width
+													mMat.rows,				// Height
+													mMat.step				// Bytes per row ('get_rowstride()' or 'step')
+												);
+		}
+		
+	// Scales the image to the desired size
+	RefPtr<Pixbuf> PixbufImage::scale(int width, int height) const
+		{
+			// Both width and height can't be zero
+			if(width<=0 and height<=0)
+				throw invalid_argument("Both width and height can not be zero at same time");
+				
+			// Get aspect ratio of original image
+			double ratio = static_cast<double>(cols())/rows();
+			/**
+			 * 'static_cast' is used for cases where you basically want to reverse an implicit conversion, 
+			 * with a few restrictions and additions. static_cast performs no runtime checks. 
+			 * This should be used if you know that you refer to an object of a specific type, 
+			 * and thus a check would be unnecessary.
+			 * 
+			 * 'dynamic_cast' is useful when you don't know what the dynamic type of the object is. 
+			 * It returns a null pointer
+			 * if the object referred to doesn't contain the type casted to as a base class 
+			 * (when you cast to a reference, a bad_cast exception is thrown in that case).
+			 */
+			 
+			 // Now either width or height is zero then adjust it to maintain the ratio
+			 if(width<=0)
+			 	width = height*ratio;
+			 else if(height<=0)
+			 	height=width/ratio;
+			 	
+			 // Now scale the image & return
+			 return this->pixbuf()->scale_simple(width, height, Gdk::INTERP_BILINEAR);
+		}
+	
+	// Returns the scaled image that fit into the given dimenstion
+	RefPtr<Pixbuf> PixbufImage::fit(int width, int height) const
+		{
+			// Width or height must not be zero
+			if(width<1 or height<1)
+				throw invalid_argument("Width and height should be greater than zero ! ");
+				
+			// Get ratio of window
+			double win_ratio = static_cast<double>(width)/height;
+			// Now, get ratio of image
+			double img_ratio = static_cast<double>(cols())/rows();
+			
+			// Fit the image 
+			if( win_ratio > img_ratio )
+				return this->scale(0, height);
+			else
+				return this->scale(width, 0);
+		}
+		
+	// Display the image using OpenCV 
+	void PixbufImage::show(int msecs) const
+		{
+			// Create a window
+			namedWindow("MatImage", CV_WINDOW_NORMAL);
+			decode(rows());
+			
+			// Display image in the window, OpenCV displays BGR
+			if(order() == BGR)
+				imshow("MatImage", mMat);
+			else
+				{
+					Mat bgr;
+					cvtColor(mMat, bgr, CV_RGB2BGR);
+					imshow("MatImage", bgr);
+				}
+			// Wait for 'msecs'
+			waitKey(msecs);			
+		}
+
+} // namespace 'Steganography' closed.
@@ -0,0 +1,257 @@
+/**
+ * This file contains the definitions of 'RowReader' class and of its PNG and PPM decoders
+ * Declaration is in 'RowReader.h'
+ */
+
+#include <cstdio>
+#include <csetjmp>
+#include <cctype>
+#include <png.h>
+#include "RowReader.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	using namespace Steganography;
+
+	/** Decodes a PNG file with libpng, converted to 8-bit RGB as OpenCV does for a color image */
+	class PngReader : public RowReader
+		{
+			private :
+				FILE* mFile;
+				png_structp mPng;
+				png_infop mInfo;
+
+				// Reads the header, returns false if the image is interlaced (its rows come in 7 passes)
+				bool start()
+					{
+						if(setjmp(png_jmpbuf(mPng)))
+							return false;
+
+						png_init_io(mPng, mFile);
+						png_read_info(mPng, mInfo);
+
+						if(png_get_interlace_type(mPng, mInfo) != PNG_INTERLACE_NONE)
+							return false;
+
+						png_set_expand(mPng);				// Palette and gray of less than 8 bits to 8 bits
+						png_set_strip_16(mPng);
+						png_set_strip_alpha(mPng);
+						png_set_gray_to_rgb(mPng);
+						png_read_update_info(mPng, mInfo);
+
+						mCols = static_cast<int>(png_get_image_width(mPng, mInfo));
+						mRows = static_cast<int>(png_get_image_height(mPng, mInfo));
+
+						return png_get_rowbytes(mPng, mInfo) == 3 * static_cast<size_t>(mCols);
+					}
+
+				// Returns false on a corrupted file
+				bool next(uint8_t* row)
+					{
+						if(setjmp(png_jmpbuf(mPng)))
+							return false;
+
+						png_read_row(mPng, row, NULL);
+						return true;
+					}
+
+			protected :
+				void read(uint8_t* row)
+					{
+						if(not next(row))
+							throw IOError(" Error ! Can't decode the image file .... ");
+					}
+
+				void close()
+					{
+						if(mPng)
+							png_destroy_read_struct(&mPng, &mInfo, NULL);
+						if(mFile)
+							fclose(mFile);
+
+						mPng = NULL;
+						mInfo = NULL;
+						mFile = NULL;
+					}
+
+			public :
+				PngReader(FILE* file) : mFile(file), mPng(NULL), mInfo(NULL)
+					{
+						mOrder = RGB;
+					}
+
+				~PngReader()
+					{
+						close();
+					}
+
+				// Returns false if the file can't be read row by row
+				bool open()
+					{
+						mPng = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+						if(mPng)
+							mInfo = png_create_info_struct(mPng);
+
+						return mInfo and start();
+					}
+		};
+
+	/** Decodes a binary PPM file ('P6') of 8-bit samples */
+	class PpmReader : public RowReader
+		{
+			private :
+				FILE* mFile;
+
+				// Reads a number of the header, skipping blanks and comments
+				bool number(int& n)
+					{
+						int c = fgetc(mFile);
+						while(c == '#' or isspace(c))
+							{
+								if(c == '#')
+									while(c != '\n' and c != EOF)
+										c = fgetc(mFile);
+								c = fgetc(mFile);
+							}
+
+						if(not isdigit(c))
+							return false;
+
+						for(n = 0; isdigit(c); c = fgetc(mFile))
+							n = 10*n + (c - '0');
+
+						// A single blank ends the number, the pixels start after the one ending the maximum value
+						return isspace(c);
+					}
+
+			protected :
+				void read(uint8_t* row)
+					{
+						if(fread(row, 3, mCols, mFile) != static_cast<size_t>(mCols))
+							throw IOError(" Error ! Can't decode the image file .... ");
+					}
+
+				void close()
+					{
+						if(mFile)
+							fclose(mFile);
+						mFile = NULL;
+					}
+
+			public :
+				PpmReader(FILE* file) : mFile(file)
+					{
+						mOrder = RGB;
+					}
+
+				~PpmReader()
+					{
+						close();
+					}
+
+				// Returns false for a PPM file with samples of more than 8 bits
+				bool open()
+					{
+						int max = 0;
+						return fgetc(mFile) == 'P' and fgetc(mFile) == '6'
+								and number(mCols) and number(mRows) and number(max)
+								and mCols > 0 and mRows > 0 and max == 255;
+					}
+		};
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Constructor
+	RowReader::RowReader() : mDone(0), mCols(0), mRows(0), mOrder(RGB)
+		{
+		}
+
+	// Destructor
+	RowReader::~RowReader()
+		{
+		}
+
+	// Open a file of a format that can be decoded row by row
+	shared_ptr<RowReader> RowReader::open(const string& filename)
+		{
+			FILE* file = fopen(filename.c_str(), "rb");
+			if(not file)
+				return nullptr;
+
+			// Check the signature, the reader owns the file from then on
+			unsigned char sig[8] = { 0 };
+			size_t n = fread(sig, 1, sizeof(sig), file);
+			rewind(file);
+
+			if(n == sizeof(sig) and png_sig_cmp(sig, 0, sizeof(sig)) == 0)
+				{
+					shared_ptr<PngReader> reader = make_shared<PngReader>(file);
+					return reader->open() ? reader : nullptr;
+				}
+
+			if(n >= 2 and sig[0] == 'P' and sig[1] == '6')
+				{
+					shared_ptr<PpmReader> reader = make_shared<PpmReader>(file);
+					return reader->open() ? reader : nullptr;
+				}
+
+			fclose(file);
+			return nullptr;
+		}
+
+	/** Getters */
+
+	int RowReader::cols() const
+		{
+			return mCols;
+		}
+
+	int RowReader::rows() const
+		{
+			return mRows;
+		}
+
+	ChannelOrder RowReader::order() const
+		{
+			return mOrder;
+		}
+
+	// Decode the rows needed
+	void RowReader::decode(uint8_t* data, size_t step, long count)
+		{
+			lock_guard<mutex> lock(mMutex);
+
+			if(count > mRows)
+				count = mRows;
+
+			if(mDone >= count)
+				return;
+
+			for( ; mDone < count; ++mDone)
+				read(data + mDone * step);
+
+			if(mDone == mRows)
+				close();
+		}
+
+	// Decode the next rows to a buffer of their own
+	int RowReader::next(uint8_t* data, size_t step, int count)
+		{
+			lock_guard<mutex> lock(mMutex);
+
+			int n = 0;
+			for( ; n < count and mDone < mRows; ++n, ++mDone)
+				read(data + n * step);
+
+			if(mDone == mRows)
+				close();
+
+			return n;
+		}
+
+}	// namespace 'Steganography' closed.
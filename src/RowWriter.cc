@@ -0,0 +1,559 @@
+/**
+ * This file contains the definitions of 'RowWriter' class and of its PNG encoder
+ * Declaration is in 'RowWriter.h'
+ */
+
+#include <cstdio>
+#include <csetjmp>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <zlib.h>
+#include <png.h>
+#include "RowWriter.h"
+#include "Error.h"
+
+using namespace std;
+
+namespace
+{
+	using namespace Steganography;
+
+	// Lower case extension of a file name
+	string extension(const string& filename)
+		{
+			size_t dot = filename.rfind('.');
+			if(dot == string::npos or filename.find('/', dot) != string::npos)
+				return "";
+
+			string ext = filename.substr(dot + 1);
+			transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+			return ext;
+		}
+
+	/** Encodes a PNG file of 8-bit RGB with libpng, non-interlaced so that it goes row by row */
+	class PngWriter : public RowWriter
+		{
+			private :
+				FILE* mFile;
+				png_structp mPng;
+				png_infop mInfo;
+				PngSettings mSettings;
+
+				// Writes the header, returns false on error
+				bool start()
+					{
+						if(setjmp(png_jmpbuf(mPng)))
+							return false;
+
+						png_init_io(mPng, mFile);
+						png_set_IHDR(mPng, mInfo, mCols, mRows, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+									 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+						static const int filters[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP, PNG_FILTER_AVG,
+													   PNG_FILTER_PAETH, PNG_ALL_FILTERS };
+
+						png_set_filter(mPng, PNG_FILTER_TYPE_BASE, filters[mSettings.filter]);
+						png_set_compression_level(mPng, mSettings.level);
+						png_set_compression_strategy(mPng, mSettings.strategy);
+
+						png_write_info(mPng, mInfo);
+
+						if(mOrder == BGR)
+							png_set_bgr(mPng);
+
+						return true;
+					}
+
+				// Returns false on error
+				bool next(const uint8_t* row)
+					{
+						if(setjmp(png_jmpbuf(mPng)))
+							return false;
+
+						png_write_row(mPng, const_cast<png_bytep>(row));
+						return true;
+					}
+
+				// Returns false on error
+				bool end()
+					{
+						if(setjmp(png_jmpbuf(mPng)))
+							return false;
+
+						png_write_end(mPng, NULL);
+						return true;
+					}
+
+				void close()
+					{
+						if(mPng)
+							png_destroy_write_struct(&mPng, &mInfo);
+						if(mFile)
+							fclose(mFile);
+
+						mPng = NULL;
+						mInfo = NULL;
+						mFile = NULL;
+					}
+
+			protected :
+				void write(const uint8_t* row)
+					{
+						if(not next(row))
+							throw IOError(" Error ! Can't write the image file .... ");
+					}
+
+				void finish()
+					{
+						bool ok = end();
+
+						if(mPng)
+							png_destroy_write_struct(&mPng, &mInfo);
+						mPng = NULL;
+						mInfo = NULL;
+
+						// The data may still be buffered, so 'fclose()' can fail too
+						ok = (fclose(mFile) == 0) and ok;
+						mFile = NULL;
+
+						if(not ok)
+							throw IOError(" Error ! Can't write the image file .... ");
+					}
+
+			public :
+				PngWriter(FILE* file, int cols, int rows, ChannelOrder order, const PngSettings& settings) :
+					RowWriter(cols, rows, order), mFile(file), mPng(NULL), mInfo(NULL), mSettings(settings)
+					{
+					}
+
+				~PngWriter()
+					{
+						close();
+					}
+
+				// Returns false if the header can't be written
+				bool open()
+					{
+						mPng = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+						if(mPng)
+							mInfo = png_create_info_struct(mPng);
+
+						return mInfo and start();
+					}
+		};
+
+	/** Size (in bytes) of the dictionary of a deflate stream */
+	const size_t WINDOW = 32768;
+
+	/** Number of bytes of filtered rows deflated by one task of 'ParallelPngWriter' */
+	const size_t BLOCK = 1 << 17;
+
+	// Writes a 32-bit number in big-endian order
+	void be32(uint8_t* out, uint32_t n)
+		{
+			out[0] = static_cast<uint8_t>(n >> 24);
+			out[1] = static_cast<uint8_t>(n >> 16);
+			out[2] = static_cast<uint8_t>(n >> 8);
+			out[3] = static_cast<uint8_t>(n);
+		}
+
+	/** Predictor of the Paeth filter */
+	inline int paeth(int a, int b, int c)
+		{
+			int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+			return (pa <= pb and pa <= pc) ? a : (pb <= pc) ? b : c;
+		}
+
+	/**
+	 * Encodes a PNG file deflating blocks of rows on several threads. The file is written by hand: the rows are
+	 * filtered, then every block of them is deflated as a raw stream primed with the bytes before it and ended by a
+	 * sync flush, so the blocks simply follow each other in the zlib stream, and each one is an IDAT chunk.
+	 * The rows are buffered until there are enough of them for every thread.
+	 */
+	class ParallelPngWriter : public RowWriter
+		{
+			private :
+				FILE* mFile;
+				PngSettings mSettings;
+				unsigned mThreads;
+
+				size_t mRowBytes;				// Bytes of a row, once filtered (with its filter type)
+				std::vector<uint8_t> mBuffer;	// The rows buffered, in RGB order
+				int mBuffered;					// Number of rows buffered
+				int mCapacity;					// Number of rows flushed at once
+				std::vector<uint8_t> mPrevious;	// The row before the ones buffered, for the filters
+				std::vector<uint8_t> mWindow;	// The last bytes of the filtered rows, for the next dictionary
+				uLong mAdler;					// Checksum of the filtered rows so far
+
+				// Writes a chunk, 'crc' being the CRC of its type and data
+				bool chunk(const char* type, const uint8_t* data, size_t size, uLong crc)
+					{
+						uint8_t head[8], tail[4];
+						be32(head, static_cast<uint32_t>(size));
+						std::memcpy(head + 4, type, 4);
+						be32(tail, static_cast<uint32_t>(crc));
+
+						return fwrite(head, 1, 8, mFile) == 8 and (size == 0 or fwrite(data, 1, size, mFile) == size)
+								and fwrite(tail, 1, 4, mFile) == 4;
+					}
+
+				bool chunk(const char* type, const uint8_t* data, size_t size)
+					{
+						// 'crc32()' of no data returns 0 and not the CRC it is given, so the type alone is the CRC of an empty chunk
+						uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+						if(size > 0)
+							crc = crc32(crc, data, static_cast<uInt>(size));
+						return chunk(type, data, size, crc);
+					}
+
+				// Filters a row to 'out' (its filter type first), 'up' being the row above it
+				void filter(const uint8_t* row, const uint8_t* up, uint8_t* out, PngSettings::Filter f) const
+					{
+						size_t n = mRowBytes - 1;
+						uint8_t * d = out + 1;
+						out[0] = static_cast<uint8_t>(f);
+
+						for(size_t i = 0; i < n; ++i)
+							{
+								int a = (i >= 3) ? row[i-3] : 0, b = up[i], c = (i >= 3) ? up[i-3] : 0;
+								switch(f)
+									{
+										case PngSettings::SUB : d[i] = static_cast<uint8_t>(row[i] - a); break;
+										case PngSettings::UP : d[i] = static_cast<uint8_t>(row[i] - b); break;
+										case PngSettings::AVERAGE : d[i] = static_cast<uint8_t>(row[i] - (a + b) / 2); break;
+										case PngSettings::PAETH : d[i] = static_cast<uint8_t>(row[i] - paeth(a, b, c)); break;
+										default : d[i] = row[i]; break;
+									}
+							}
+					}
+
+				// Filters a row with the filter of the settings, the one giving the least sum for 'ADAPTIVE' (as libpng)
+				void filter(const uint8_t* row, const uint8_t* up, uint8_t* out) const
+					{
+						if(mSettings.filter != PngSettings::ADAPTIVE)
+							{
+								filter(row, up, out, mSettings.filter);
+								return;
+							}
+
+						std::vector<uint8_t> tmp(mRowBytes);
+						unsigned long best = ~0ul;
+
+						for(int f = PngSettings::NONE; f <= PngSettings::PAETH; ++f)
+							{
+								filter(row, up, tmp.data(), static_cast<PngSettings::Filter>(f));
+
+								unsigned long sum = 0;
+								for(size_t i = 1; i < mRowBytes; ++i)
+									sum += (tmp[i] < 128) ? tmp[i] : 256 - tmp[i];
+
+								if(sum < best)
+									{
+										best = sum;
+										std::copy(tmp.begin(), tmp.end(), out);
+									}
+							}
+					}
+
+				// Filters and deflates the rows buffered, and writes them
+				void flush(bool last)
+					{
+						// The filtered rows follow the window of the ones before, which primes the first block
+						size_t keep = mWindow.size();
+						std::vector<uint8_t> data(keep + mBuffered * mRowBytes);
+						std::copy(mWindow.begin(), mWindow.end(), data.begin());
+
+						size_t stride = 3*static_cast<size_t>(mCols);
+						for(int r = 0; r < mBuffered; ++r)
+							filter(mBuffer.data() + r * stride, (r > 0) ? mBuffer.data() + (r-1) * stride : mPrevious.data(),
+								   data.data() + keep + r * mRowBytes);
+
+						size_t size = data.size() - keep;
+						size_t blocks = std::max<size_t>(1, (size + BLOCK - 1) / BLOCK);
+
+						// Every block is an IDAT chunk of its own: its type, then its data, then room for the checksum
+						std::vector<std::vector<uint8_t> > out(blocks);
+						std::vector<uLong> crcs(blocks), adlers(blocks);
+						std::atomic<size_t> next(0);
+						std::atomic<bool> ok(true);
+
+						auto work = [&]()
+							{
+								for(size_t b = next++; b < blocks; b = next++)
+									{
+										size_t first = keep + b * BLOCK, count = std::min(BLOCK, data.size() - first);
+										bool end = last and b + 1 == blocks;
+
+										z_stream z;
+										std::memset(&z, 0, sizeof(z));
+										if(deflateInit2(&z, mSettings.level, Z_DEFLATED, -15, 8, mSettings.strategy) != Z_OK)
+											{
+												ok = false;
+												continue;
+											}
+
+										size_t dict = std::min(first, WINDOW);
+										if(dict > 0 and mSettings.level > 0)
+											deflateSetDictionary(&z, data.data() + first - dict, static_cast<uInt>(dict));
+
+										std::vector<uint8_t>& o = out[b];
+										o.resize(4 + deflateBound(&z, count) + 16);
+										std::memcpy(o.data(), "IDAT", 4);
+
+										z.next_in = data.data() + first;
+										z.avail_in = static_cast<uInt>(count);
+										z.next_out = o.data() + 4;
+										z.avail_out = static_cast<uInt>(o.size() - 4);
+
+										if(deflate(&z, end ? Z_FINISH : Z_SYNC_FLUSH) != (end ? Z_STREAM_END : Z_OK) or z.avail_in != 0)
+											ok = false;
+
+										o.resize(o.size() - z.avail_out);
+										deflateEnd(&z);
+
+										adlers[b] = adler32(1, data.data() + first, static_cast<uInt>(count));
+										crcs[b] = crc32(0, o.data(), static_cast<uInt>(o.size()));
+									}
+							};
+
+						std::vector<std::thread> threads;
+						for(unsigned t = 1; t < std::min<size_t>(mThreads, blocks); ++t)
+							threads.emplace_back(work);
+						work();
+						for(std::thread& t : threads)
+							t.join();
+
+						if(not ok)
+							throw IOError(" Error ! Can't compress the image .... ");
+
+						for(size_t b = 0; b < blocks; ++b)
+							{
+								size_t first = keep + b * BLOCK, count = std::min(BLOCK, data.size() - first);
+								mAdler = adler32_combine(mAdler, adlers[b], static_cast<z_off_t>(count));
+
+								// The checksum of the whole stream ends the last chunk
+								uLong crc = crcs[b];
+								if(last and b + 1 == blocks)
+									{
+										uint8_t sum[4];
+										be32(sum, static_cast<uint32_t>(mAdler));
+										out[b].insert(out[b].end(), sum, sum + 4);
+										crc = crc32(crc, sum, 4);
+									}
+
+								if(not chunk("IDAT", out[b].data() + 4, out[b].size() - 4, crc))
+									throw IOError(" Error ! Can't write the image file .... ");
+							}
+
+						// What the next rows need: the row above them and the window before them
+						if(mBuffered > 0)
+							std::copy(mBuffer.begin() + (mBuffered - 1) * stride, mBuffer.begin() + mBuffered * stride,
+									  mPrevious.begin());
+						mWindow.assign(data.end() - std::min(data.size(), WINDOW), data.end());
+						mBuffered = 0;
+					}
+
+				void close()
+					{
+						if(mFile)
+							fclose(mFile);
+						mFile = NULL;
+					}
+
+			protected :
+				void write(const uint8_t* row)
+					{
+						uint8_t * dst = mBuffer.data() + mBuffered * 3*static_cast<size_t>(mCols);
+
+						if(mOrder == BGR)
+							for(int px = 0; px < 3*mCols; px += 3)
+								{
+									dst[px] = row[px + 2];
+									dst[px + 1] = row[px + 1];
+									dst[px + 2] = row[px];
+								}
+						else
+							std::memcpy(dst, row, 3*static_cast<size_t>(mCols));
+
+						if(++mBuffered == mCapacity)
+							flush(false);
+					}
+
+				void finish()
+					{
+						flush(true);
+
+						bool ok = chunk("IEND", NULL, 0);
+						ok = (fclose(mFile) == 0) and ok;
+						mFile = NULL;
+
+						if(not ok)
+							throw IOError(" Error ! Can't write the image file .... ");
+					}
+
+			public :
+				ParallelPngWriter(FILE* file, int cols, int rows, ChannelOrder order, const PngSettings& settings,
+								  unsigned threads) :
+					RowWriter(cols, rows, order), mFile(file), mSettings(settings), mThreads(threads),
+					mRowBytes(1 + 3*static_cast<size_t>(cols)), mBuffered(0), mAdler(adler32(0, NULL, 0))
+					{
+						// Enough rows for 2 blocks per thread
+						mCapacity = static_cast<int>(std::max<size_t>(1, 2 * threads * BLOCK / mRowBytes));
+						mCapacity = std::min(mCapacity, rows);
+						mBuffer.resize(mCapacity * 3*static_cast<size_t>(cols));
+						mPrevious.assign(3*static_cast<size_t>(cols), 0);
+					}
+
+				~ParallelPngWriter()
+					{
+						close();
+					}
+
+				// Writes the signature and the header, returns false on error
+				bool open()
+					{
+						static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+						uint8_t ihdr[13];
+						be32(ihdr, static_cast<uint32_t>(mCols));
+						be32(ihdr + 4, static_cast<uint32_t>(mRows));
+						ihdr[8] = 8;		// Bits per sample
+						ihdr[9] = 2;		// RGB
+						ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+						// The zlib header, with the level it tells
+						int flevel = (mSettings.level <= 1) ? 0 : (mSettings.level <= 5) ? 1 : (mSettings.level == 6) ? 2 : 3;
+						uint8_t zhead[2] = { 0x78, static_cast<uint8_t>(flevel << 6) };
+						zhead[1] |= 31 - (zhead[0] * 256 + zhead[1]) % 31;
+
+						return fwrite(signature, 1, 8, mFile) == 8 and chunk("IHDR", ihdr, sizeof(ihdr))
+								and chunk("IDAT", zhead, sizeof(zhead));
+					}
+		};
+
+}	// Unnamed namespace closed.
+
+namespace Steganography
+{
+	// Settings of a preset
+	PngSettings PngSettings::preset(const string& name)
+		{
+			PngSettings s;
+
+			if(name == "default")
+				return s;
+
+			s.threads = 0;
+			if(name == "fastest")
+				{
+					s.level = 0;
+					s.filter = NONE;
+					return s;
+				}
+
+			if(name == "fast")
+				{
+					s.filter = UP;
+					return s;
+				}
+
+			if(name == "small")
+				{
+					s.filter = PAETH;
+					return s;
+				}
+
+			throw Error(" Unknown PNG preset '" + name + "' ! ");
+		}
+
+	// Filter of a name
+	PngSettings::Filter PngSettings::filter_of(const string& name)
+		{
+			static const char* names[] = { "none", "sub", "up", "average", "paeth", "adaptive" };
+
+			for(int f = NONE; f <= ADAPTIVE; ++f)
+				if(name == names[f])
+					return static_cast<Filter>(f);
+
+			throw Error(" Unknown PNG filter '" + name + "' ! ");
+		}
+
+	// Constructor
+	RowWriter::RowWriter(int cols, int rows, ChannelOrder order) : mDone(0), mCols(cols), mRows(rows), mOrder(order)
+		{
+		}
+
+	// Destructor
+	RowWriter::~RowWriter()
+		{
+		}
+
+	// Whether the format is encoded row by row
+	bool RowWriter::supported(const string& filename)
+		{
+			return extension(filename) == "png";
+		}
+
+	// Create a file of a format that can be encoded row by row
+	shared_ptr<RowWriter> RowWriter::open(const string& filename, int cols, int rows, ChannelOrder order,
+										  const PngSettings& png)
+		{
+			if(not supported(filename) or cols <= 0 or rows <= 0)
+				return nullptr;
+
+			if(png.level < 0 or png.level > 9)
+				throw Error(" The level of PNG should be from 0 to 9 ! ");
+
+			unsigned threads = png.threads ? png.threads : std::max(1u, thread::hardware_concurrency());
+
+			FILE* file = fopen(filename.c_str(), "wb");
+			if(not file)
+				throw IOError(" Error ! Can't create the file '" + filename + "' .... ");
+
+			// The writer owns the file from then on
+			if(threads > 1)
+				{
+					shared_ptr<ParallelPngWriter> writer = make_shared<ParallelPngWriter>(file, cols, rows, order, png,
+																						  threads);
+					if(not writer->open())
+						throw IOError(" Error ! Can't write the image file .... ");
+					return writer;
+				}
+
+			shared_ptr<PngWriter> writer = make_shared<PngWriter>(file, cols, rows, order, png);
+			if(not writer->open())
+				throw IOError(" Error ! Can't write the image file .... ");
+
+			return writer;
+		}
+
+	/** Getters */
+
+	int RowWriter::cols() const
+		{
+			return mCols;
+		}
+
+	int RowWriter::rows() const
+		{
+			return mRows;
+		}
+
+	// Encode the next rows
+	void RowWriter::encode(const uint8_t* data, size_t step, int count)
+		{
+			if(mDone == mRows)
+				return;
+
+			for(int n = 0; n < count and mDone < mRows; ++n, ++mDone)
+				write(data + n * step);
+
+			if(mDone == mRows)
+				finish();
+		}
+
+}	// namespace 'Steganography' closed.
@@ -5,6 +5,7 @@
  
 #include "TextFile.h"
 #include <fstream>
+#include <iterator>
 
 using namespace std;
 
@@ -31,28 +32,33 @@ namespace Steganography
 	TextFile TextFile::open(const string& filename)
 		{
 			TextFile t;
-			ifstream file(filename.c_str());
+			ifstream file(filename.c_str(), ios::binary);
 			/**
 			 * c_str returns a const char* that points to a null-terminated string (i.e. a C-style string). 
 			 * It is useful when you want to pass the "contents" of an std::string 
 			 * to a function that expects to work with a C-style string. 
 			 */
 			 
-			 string line;
-			 getline(file, t.mText);
 			 /**
-			  * (#)The first variable:
-			  * Pointer to an array of characters where extracted characters are stored as a c-string.
-			  * (#)The second variable:
-			  * Maximum number of characters to write to s (including the terminating null character). 
-			  * If the function stops reading because this limit is reached without finding the delimiting character, 
-			  * the failbit internal flag is set. 
-			  * streamsize is a signed integral type.
+			  * The file is read as it is (binary-safe) with one 'read()' into a buffer of its size, rather than line
+			  * by line. If its size can't be known (e.g. a pipe), it is read until its end.
 			  */
-			  
-			 
-			 while( getline(file, line))
-			 	t.mText += "\n"  + line;
+			 if(file.seekg(0, ios::end))
+			 	{
+			 		streamoff size = file.tellg();
+			 		file.seekg(0, ios::beg);
+			 		
+			 		if(size > 0)
+			 			{
+			 				t.mText.resize(static_cast<string::size_type>(size));
+			 				file.read(&t.mText[0], size);
+			 				t.mText.resize(static_cast<string::size_type>(file.gcount()));
+			 				return (t);
+			 			}
+			 	}
+			 	
+			 file.clear();
+			 t.mText.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
 			 
 			 return (t);
 		}
@@ -106,15 +112,10 @@ namespace Steganography
 			return this->append(textFile.str());
 		}
 		
-	// Save the text file to disk
+	// Save the text file to disk, with one 'write()'
 	void TextFile::save(const string& filename)
 		{
-			ofstream file(filename.c_str());
-			
-			string::iterator sit;
-			for(sit = mText.begin() ; sit != mText.end() ; ++sit)
-				{
-					file.put(*sit);
-				}
+			ofstream file(filename.c_str(), ios::binary);
+			file.write(mText.data(), mText.size());
 		}
 } // namespace 'Steganography' closed.
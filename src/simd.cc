@@ -0,0 +1,338 @@
+/**
+ * This file defines the kernels declared in 'simd.h'
+ *
+ * The vector kernels handle 16 bytes (144 samples, i.e. 9 vectors of 16 samples) per step, 32 for AVX2 with one
+ * chunk of 16 bytes in each 128-bit lane. For every vector of samples the bytes are spread to the samples storing
+ * them with a shuffle, then the per sample masks of the key schedule choose the bit of the byte and the plane of the
+ * sample to blend. The last bytes (less than a step) are done by the scalar kernels.
+ * Only the masks depend on the channel order: a group is 9 samples in either order, so the shuffles do not change.
+ * To hide several bytes per group the plane masks are shifted, which is the same for every sample.
+ */
+
+#include "simd.h"
+#include "bitplane.h"
+#include <cstring>
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define STEG_X86
+#endif
+
+using namespace std;
+
+namespace Steganography
+{
+	namespace simd
+	{
+		namespace
+		{
+			// Scalar kernels, always available, with the channel order known at compile time
+			template<ChannelOrder O>
+			void embed_scalar(uint8_t* s, const uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							  unsigned shift)
+				{
+					for(size_t n = 0; n < count; ++n, s += 9)
+						{
+							const KeySchedule::Entry& e = ks[k];
+							if(++k == ks.period()) k = 0;
+
+							bitplane::scatter<O>(s, bytes[n], e.ignore, e.planes, shift);
+						}
+				}
+
+			template<ChannelOrder O>
+			void extract_scalar(const uint8_t* s, uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+								unsigned shift)
+				{
+					for(size_t n = 0; n < count; ++n, s += 9)
+						{
+							const KeySchedule::Entry& e = ks[k];
+							if(++k == ks.period()) k = 0;
+
+							bytes[n] = bitplane::gather<O>(s, e.ignore, e.planes, shift);
+						}
+				}
+
+			void embed_scalar(uint8_t* s, const uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							  ChannelOrder order, unsigned shift)
+				{
+					if(order == BGR)
+						embed_scalar<BGR>(s, bytes, count, ks, k, shift);
+					else
+						embed_scalar<RGB>(s, bytes, count, ks, k, shift);
+				}
+
+			void extract_scalar(const uint8_t* s, uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+								ChannelOrder order, unsigned shift)
+				{
+					if(order == BGR)
+						extract_scalar<BGR>(s, bytes, count, ks, k, shift);
+					else
+						extract_scalar<RGB>(s, bytes, count, ks, k, shift);
+				}
+
+			// ORs the bits read from the 9 samples of a byte, they never overlap
+			inline uint8_t fold(const uint8_t* c)
+				{
+					uint64_t x;
+					memcpy(&x, c, 8);
+					x |= x >> 32;
+					x |= x >> 16;
+					x |= x >> 8;
+					return static_cast<uint8_t>(x) | c[8];
+				}
+
+		#ifdef STEG_X86
+
+			// For each of the 9 vectors of samples of 16 bytes, the byte stored by each sample
+			alignas(16) const uint8_t SPREAD[9][16] = {
+				{  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,  1,  1,  1 },
+				{  1,  1,  2,  2,  2,  2,  2,  2,  2,  2,  2,  3,  3,  3,  3,  3 },
+				{  3,  3,  3,  3,  4,  4,  4,  4,  4,  4,  4,  4,  4,  5,  5,  5 },
+				{  5,  5,  5,  5,  5,  5,  6,  6,  6,  6,  6,  6,  6,  6,  6,  7 },
+				{  7,  7,  7,  7,  7,  7,  7,  7,  8,  8,  8,  8,  8,  8,  8,  8 },
+				{  8,  9,  9,  9,  9,  9,  9,  9,  9,  9, 10, 10, 10, 10, 10, 10 },
+				{ 10, 10, 10, 11, 11, 11, 11, 11, 11, 11, 11, 11, 12, 12, 12, 12 },
+				{ 12, 12, 12, 12, 12, 13, 13, 13, 13, 13, 13, 13, 13, 13, 14, 14 },
+				{ 14, 14, 14, 14, 14, 14, 14, 15, 15, 15, 15, 15, 15, 15, 15, 15 }
+			};
+
+			// SSE4.1 kernels, 16 bytes per step
+			__attribute__((target("sse4.1")))
+			void embed_sse41(uint8_t* s, const uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							 ChannelOrder order, unsigned shift)
+				{
+					const __m128i sh = _mm_cvtsi32_si128(static_cast<int>(shift));
+
+					size_t n = 0;
+					for( ; n + 16 <= count; n += 16)
+						{
+							const uint8_t* bits = ks.bits(k, order);
+							const uint8_t* planes = ks.planes(k, order);
+							uint8_t* d = s + 9*n;
+
+							__m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + n));
+
+							for(int v = 0; v < 9; ++v)
+								{
+									__m128i x = _mm_shuffle_epi8(p, _mm_load_si128(reinterpret_cast<const __m128i*>(SPREAD[v])));
+									__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + 16*v));
+									__m128i m = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 16*v)), sh);
+									__m128i smp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + 16*v));
+
+									// Set the plane where the bit is 1, clear it elsewhere, the ignored color has no plane
+									__m128i one = _mm_cmpeq_epi8(_mm_and_si128(x, b), b);
+									smp = _mm_blendv_epi8(_mm_andnot_si128(m, smp), _mm_or_si128(smp, m), one);
+
+									_mm_storeu_si128(reinterpret_cast<__m128i*>(d + 16*v), smp);
+								}
+
+							k = (k + 16) % ks.period();
+						}
+
+					embed_scalar(s + 9*n, bytes + n, count - n, ks, k, order, shift);
+				}
+
+			__attribute__((target("sse4.1")))
+			void extract_sse41(const uint8_t* s, uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							   ChannelOrder order, unsigned shift)
+				{
+					alignas(16) uint8_t c[144];
+					const __m128i zero = _mm_setzero_si128();
+					const __m128i sh = _mm_cvtsi32_si128(static_cast<int>(shift));
+
+					size_t n = 0;
+					for( ; n + 16 <= count; n += 16)
+						{
+							const uint8_t* bits = ks.bits(k, order);
+							const uint8_t* planes = ks.planes(k, order);
+							const uint8_t* d = s + 9*n;
+
+							for(int v = 0; v < 9; ++v)
+								{
+									__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bits + 16*v));
+									__m128i m = _mm_sll_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(planes + 16*v)), sh);
+									__m128i smp = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + 16*v));
+
+									// The bit of the byte stored by the sample if its plane is set, else 0
+									__m128i off = _mm_cmpeq_epi8(_mm_and_si128(smp, m), zero);
+									_mm_store_si128(reinterpret_cast<__m128i*>(c + 16*v), _mm_andnot_si128(off, b));
+								}
+
+							for(int j = 0; j < 16; ++j)
+								bytes[n + j] = fold(c + 9*j);
+
+							k = (k + 16) % ks.period();
+						}
+
+					extract_scalar(s + 9*n, bytes + n, count - n, ks, k, order, shift);
+				}
+
+			// Loads or stores 2 chunks of 16 bytes as the 2 lanes of an AVX2 vector
+			__attribute__((target("avx2")))
+			inline __m256i load2(const uint8_t* lo, const uint8_t* hi)
+				{
+					__m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo));
+					__m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(hi));
+					return _mm256_inserti128_si256(_mm256_castsi128_si256(l), h, 1);
+				}
+
+			__attribute__((target("avx2")))
+			inline void store2(uint8_t* lo, uint8_t* hi, __m256i x)
+				{
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(lo), _mm256_castsi256_si128(x));
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(hi), _mm256_extracti128_si256(x, 1));
+				}
+
+			// AVX2 kernels, 32 bytes per step, the masks of the second chunk are 'SPAN' covered
+			__attribute__((target("avx2")))
+			void embed_avx2(uint8_t* s, const uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							 ChannelOrder order, unsigned shift)
+				{
+					const __m128i sh = _mm_cvtsi32_si128(static_cast<int>(shift));
+
+					size_t n = 0;
+					for( ; n + 32 <= count; n += 32)
+						{
+							const uint8_t* bits = ks.bits(k, order);
+							const uint8_t* planes = ks.planes(k, order);
+							uint8_t* d = s + 9*n;
+
+							__m256i p = load2(bytes + n, bytes + n + 16);
+
+							for(int v = 0; v < 9; ++v)
+								{
+									__m256i spread = _mm256_broadcastsi128_si256(
+														_mm_load_si128(reinterpret_cast<const __m128i*>(SPREAD[v])));
+									__m256i x = _mm256_shuffle_epi8(p, spread);
+									__m256i b = load2(bits + 16*v, bits + 144 + 16*v);
+									__m256i m = _mm256_sll_epi16(load2(planes + 16*v, planes + 144 + 16*v), sh);
+									__m256i smp = load2(d + 16*v, d + 144 + 16*v);
+
+									__m256i one = _mm256_cmpeq_epi8(_mm256_and_si256(x, b), b);
+									smp = _mm256_blendv_epi8(_mm256_andnot_si256(m, smp), _mm256_or_si256(smp, m), one);
+
+									store2(d + 16*v, d + 144 + 16*v, smp);
+								}
+
+							k = (k + 32) % ks.period();
+						}
+
+					embed_sse41(s + 9*n, bytes + n, count - n, ks, k, order, shift);
+				}
+
+			__attribute__((target("avx2")))
+			void extract_avx2(const uint8_t* s, uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k,
+							   ChannelOrder order, unsigned shift)
+				{
+					alignas(32) uint8_t c[288];
+					const __m256i zero = _mm256_setzero_si256();
+					const __m128i sh = _mm_cvtsi32_si128(static_cast<int>(shift));
+
+					size_t n = 0;
+					for( ; n + 32 <= count; n += 32)
+						{
+							const uint8_t* bits = ks.bits(k, order);
+							const uint8_t* planes = ks.planes(k, order);
+							const uint8_t* d = s + 9*n;
+
+							for(int v = 0; v < 9; ++v)
+								{
+									__m256i b = load2(bits + 16*v, bits + 144 + 16*v);
+									__m256i m = _mm256_sll_epi16(load2(planes + 16*v, planes + 144 + 16*v), sh);
+									__m256i smp = load2(d + 16*v, d + 144 + 16*v);
+
+									__m256i off = _mm256_cmpeq_epi8(_mm256_and_si256(smp, m), zero);
+									store2(c + 16*v, c + 144 + 16*v, _mm256_andnot_si256(off, b));
+								}
+
+							for(int j = 0; j < 32; ++j)
+								bytes[n + j] = fold(c + 9*j);
+
+							k = (k + 32) % ks.period();
+						}
+
+					extract_sse41(s + 9*n, bytes + n, count - n, ks, k, order, shift);
+				}
+
+		#endif	// 'STEG_X86' closed.
+
+			// The best instruction set supported by the processor
+			Level supported()
+				{
+				#ifdef STEG_X86
+					__builtin_cpu_init();
+					if(__builtin_cpu_supports("avx2"))
+						return AVX2;
+					if(__builtin_cpu_supports("sse4.1"))
+						return SSE41;
+				#endif
+					return SCALAR;
+				}
+
+			// The instruction set in use, read by the workers of 'parallel_for_' while 'use()' may change it
+			atomic<Level> gLevel(supported());
+
+		}	// Unnamed namespace closed.
+
+		// Return the instruction set in use
+		Level level()
+			{
+				return gLevel.load(memory_order_relaxed);
+			}
+
+		// Use the given instruction set if supported
+		Level use(Level l)
+			{
+				Level best = supported();
+				l = (l < best) ? l : best;
+				gLevel.store(l, memory_order_relaxed);
+				return l;
+			}
+
+		// Name of the instruction set
+		string name(Level l)
+			{
+				switch(l)
+					{
+						case AVX2 :
+							return "AVX2";
+						case SSE41 :
+							return "SSE4.1";
+						default :
+							return "scalar";
+					}
+			}
+
+		// Hide the bytes with the instruction set in use
+		void embed(uint8_t* s, const uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k, ChannelOrder order,
+				   unsigned shift)
+			{
+			#ifdef STEG_X86
+				Level l = gLevel.load(memory_order_relaxed);
+				if(l == AVX2)
+					return embed_avx2(s, bytes, count, ks, k, order, shift);
+				if(l == SSE41)
+					return embed_sse41(s, bytes, count, ks, k, order, shift);
+			#endif
+				embed_scalar(s, bytes, count, ks, k, order, shift);
+			}
+
+		// Read the bytes with the instruction set in use
+		void extract(const uint8_t* s, uint8_t* bytes, size_t count, const KeySchedule& ks, size_t k, ChannelOrder order,
+					 unsigned shift)
+			{
+			#ifdef STEG_X86
+				Level l = gLevel.load(memory_order_relaxed);
+				if(l == AVX2)
+					return extract_avx2(s, bytes, count, ks, k, order, shift);
+				if(l == SSE41)
+					return extract_sse41(s, bytes, count, ks, k, order, shift);
+			#endif
+				extract_scalar(s, bytes, count, ks, k, order, shift);
+			}
+
+	}	// namespace 'simd' closed.
+
+}	// namespace 'Steganography' closed.
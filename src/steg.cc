@@ -8,9 +8,18 @@
 #include <iostream>
 #include <string>
 #include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <iterator>
 #include <getopt.h>
+#include <sys/stat.h>
 #include "MatImage.h"
-#include "TextFile.h"
+#include "Pipeline.h"
+#include "JpegImage.h"
+#include "Capacity.h"
+#include "Batch.h"
+#include "Formats.h"
 #include "Error.h"
 
 using namespace std;
@@ -21,6 +30,9 @@ string PROGRAM = "steg";
 
 // Helper functions
 void print_help();
+int run_batch(const string& batch, const string& text_filename, const string& key, const string& out_dir,
+              unsigned jobs, bool verify, const StegOptions& options);
+int print_capacity(const string& image_filename, const string& text_filename, const StegOptions& options);
 
 //=========================== main() ==========================================
 int main(int argc, char** argv)
@@ -30,6 +42,23 @@ int main(int argc, char** argv)
     string text_filename, text;
     string key;
     string stego_filename = "out.png";
+    string batch;
+    bool out_given = false;
+    bool in_place = false;
+    bool redirect = false;
+    bool verify = false;
+    bool capacity = false;
+    unsigned jobs = 0;
+    unsigned bits = 1;
+    bool scatter = false;
+    string codec = "none";
+    int level = 0;
+    string cipher = "none";
+    string digest = "sha1";
+    string preset;
+    string png_filter;
+    int png_level = -1, png_threads = -1;
+    enum { PNG_LEVEL = 256, PNG_FILTER, PNG_THREADS };
 
     // Command line options
     int option_index = 0;
@@ -38,13 +67,29 @@ int main(int argc, char** argv)
         {"text-file", required_argument, 0, 'f'},
         {"password",  required_argument, 0, 'p'},
         {"out-file",  required_argument, 0, 'o'},
+        {"batch",     required_argument, 0, 'b'},
+        {"jobs",      required_argument, 0, 'j'},
+        {"in-place",  no_argument,       0, 'i'},
+        {"redirect",  no_argument,       0, 'r'},
+        {"verify",    no_argument,       0, 'V'},
+        {"capacity",  no_argument,       0, 'C'},
+        {"bits",      required_argument, 0, 'k'},
+        {"scatter",   no_argument,       0, 's'},
+        {"compress",  required_argument, 0, 'z'},
+        {"level",     required_argument, 0, 'L'},
+        {"encrypt",   optional_argument, 0, 'e'},
+        {"digest",    required_argument, 0, 'd'},
+        {"png",       required_argument, 0, 'P'},
+        {"png-level", required_argument, 0, PNG_LEVEL},
+        {"png-filter",  required_argument, 0, PNG_FILTER},
+        {"png-threads", required_argument, 0, PNG_THREADS},
         {0,0,0,0}
     };
 
     // Parse every option
     while (true)
     {
-        int c = getopt_long(argc, argv, ":hf:p:o:", long_options, &option_index);
+        int c = getopt_long(argc, argv, ":hf:p:o:b:j:irVCk:sz:L:e::d:P:", long_options, &option_index);
 
         // If parsing is complete, break out of loop
         if (c == -1) break;
@@ -65,6 +110,71 @@ int main(int argc, char** argv)
 
             case 'o':
                 stego_filename = string(optarg);
+                out_given = true;
+                break;
+
+            case 'b':
+                batch = string(optarg);
+                break;
+
+            case 'j':
+                jobs = static_cast<unsigned>(atoi(optarg));
+                break;
+
+            case 'i':
+                in_place = true;
+                break;
+
+            case 'r':
+                redirect = true;
+                break;
+
+            case 'V':
+                verify = true;
+                break;
+
+            case 'C':
+                capacity = true;
+                break;
+
+            case 'k':
+                bits = static_cast<unsigned>(atoi(optarg));
+                break;
+
+            case 's':
+                scatter = true;
+                break;
+
+            case 'z':
+                codec = string(optarg);
+                break;
+
+            case 'L':
+                level = atoi(optarg);
+                break;
+
+            case 'e':
+                cipher = optarg ? string(optarg) : crypto::name(crypto::preferred());
+                break;
+
+            case 'd':
+                digest = string(optarg);
+                break;
+
+            case 'P':
+                preset = string(optarg);
+                break;
+
+            case PNG_LEVEL:
+                png_level = atoi(optarg);
+                break;
+
+            case PNG_FILTER:
+                png_filter = string(optarg);
+                break;
+
+            case PNG_THREADS:
+                png_threads = atoi(optarg);
                 break;
 
             case ':': // Missing argument
@@ -78,6 +188,32 @@ int main(int argc, char** argv)
         }   // 'switch (c)' closed.
     }   // 'while (true)' closed.
 
+    // The options of 'steg()', for one image or a batch
+    MatImage I;
+    try
+    {
+        I.set_depth(bits);
+        I.set_scatter(scatter);
+        I.set_compression(compression::codec(codec), level);
+        I.set_encryption(crypto::algorithm(cipher));
+        I.set_digest(hashing::algorithm(digest));
+    }
+    catch (const Error& e)
+    {
+        error(e);
+    }
+
+    // Batch mode, from a manifest or a directory
+    if (not batch.empty())
+    {
+        if (argc != optind)
+        {
+            print_help();
+            return 1;
+        }
+        return run_batch(batch, text_filename, key, out_given ? stego_filename : ".", jobs, verify, I.options());
+    }
+
     // There should be exactly 1 non-option argument
     if ( (argc - optind) != 1 ) 
     {
@@ -85,19 +221,75 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // Open the image
+    // Open the image, uncompressed files are mapped instead of decoded
     image_filename = string(argv[optind++]);
-    MatImage I;
+    if (in_place)
+    {
+        if (out_given)
+            error("Options -i and -o can't be used together");
+        stego_filename = image_filename;
+    }
+
+    // A JPEG stego-image of a JPEG image hides the text in its DCT coefficients, it stays JPEG
+    bool dct = JpegImage::supported(image_filename) and JpegImage::supported(stego_filename);
+
+    // Any other lossy stego-image would lose the text, it is saved as PNG instead if asked to
+    if (redirect and not in_place and not dct and not formats::lossless(stego_filename))
+    {
+        string lossless = formats::lossless_name(stego_filename);
+        cout << ":: '" << stego_filename << "' would lose the text, saving as '" << lossless << "'" << endl;
+        stego_filename = lossless;
+    }
+
+    // A PNG stego-image of a PNG or PPM image is written while the image is decoded, band by band
+    shared_ptr<Pipeline> pipeline;
+    unique_ptr<JpegImage> jpeg;
+    PngSettings png;
+    bool png_given = not preset.empty() or png_level >= 0 or not png_filter.empty() or png_threads >= 0;
     try 
     {
-        I = image_filename;
+        // Otherwise it is refused before anything is decoded
+        if (not dct)
+            formats::check(stego_filename);
+
+        // The PNG options change the preset
+        png = PngSettings::preset(preset.empty() ? "default" : preset);
+        if (png_level > 9)
+            error("The level of PNG should be from 0 to 9");
+        if (png_level >= 0)
+            png.level = png_level;
+        if (not png_filter.empty())
+            png.filter = PngSettings::filter_of(png_filter);
+        if (png_threads >= 0)
+            png.threads = static_cast<unsigned>(png_threads);
+
+        // Only the header of the image is read
+        if (capacity)
+            return print_capacity(image_filename, text_filename, I.options());
+
+        if (dct)
+        {
+            jpeg.reset(new JpegImage(image_filename));
+            jpeg->set_options(I.options());
+        }
+        else if (not in_place and not scatter)
+            pipeline = Pipeline::open(image_filename, stego_filename, png);
+
+        if (not pipeline and not jpeg)
+        {
+            StegOptions options = I.options();
+            // Mapped privately even in place, the file is only written by 'update()' once 'steg()' succeeded
+            I = MatImage::map(image_filename, ImageMap::PRIVATE);
+            I.set_options(options);
+        }
     } 
-    catch (IOError e) 
+    catch (const Error& e) 
     {
         error(e);
     }
 
-    // Get the text
+    // Get the text, a text file (or any binary file) is hidden as it is read
+    ifstream text_file;
     if (text_filename.empty()) 
     {
         string line;
@@ -109,8 +301,9 @@ int main(int argc, char** argv)
     } 
     else 
     {
-        TextFile textfile = TextFile::open(text_filename);
-        text = textfile.str();
+        text_file.open(text_filename.c_str(), ios::binary);
+        if (not text_file)
+            error("Can't open the text file '" + text_filename + "'");
     }
 
     // Get the password
@@ -123,8 +316,82 @@ int main(int argc, char** argv)
     // Steg
     try 
     {
-        I.steg(text, key).save(stego_filename);
+        StegReport r;
+        double save = 0;
+        KeySchedule ks(key);
+
+        if (pipeline or jpeg)
+        {
+            // The header goes before the text, so all of it is read first
+            if (text_file.is_open())
+            {
+                text.assign(istreambuf_iterator<char>(text_file), istreambuf_iterator<char>());
+                if (text_file.bad())
+                    error("Can't read the text file '" + text_filename + "'");
+            }
+        }
+
+        if (pipeline)
+            r = pipeline->run(reinterpret_cast<const uint8_t *>(text.data()), text.size(), ks, I.options());
+        else if (jpeg)
+        {
+            jpeg->steg(reinterpret_cast<const uint8_t *>(text.data()), text.size(), ks);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            jpeg->save(stego_filename);
+            save = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            r = jpeg->report();
+        }
+        else
+        {
+            if (text_file.is_open())
+                I.steg(text_file, ks);
+            else
+                I.steg(text, ks);
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if (in_place)
+                I.update(stego_filename);
+            else if (png_given)
+                I.save(stego_filename, png);
+            else
+                I.save(stego_filename);
+            save = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            r = I.report();
+        }
         cout << ":: Stego-image saved as '" << stego_filename << "'" << endl;
+
+        // Decode the payload rows of the file again, they must hold the bits hidden
+        if (verify)
+        {
+            Digest hidden = pipeline ? pipeline->fingerprint() : jpeg ? jpeg->fingerprint(ks) : I.fingerprint(ks);
+            bool same = false;
+            try
+            {
+                if (jpeg)
+                    same = (JpegImage(stego_filename).fingerprint(ks) == hidden);
+                else
+                    same = (MatImage::stream(stego_filename).fingerprint(ks) == hidden);
+            }
+            catch (const Error&)
+            {
+            }
+            if (not same)
+                error("The stego-image '" + stego_filename + "' does not hold the text, its format is not lossless");
+            cout << ":: Stego-image verified" << endl;
+        }
+
+        // Report what compression saved, and where the time went
+        if (codec != "none")
+        {
+            cout << ":: Text of " << r.raw << " bytes hidden as " << r.stored << " bytes ("
+                 << ((r.stored < r.raw) ? codec : "not compressed") << ")" << endl
+                 << fixed << setprecision(3) << ":: Compressed in " << r.compress << " s, ";
+            if (pipeline)
+                cout << "hidden and saved in " << r.embed << " s" << endl;
+            else
+                cout << "hidden in " << r.embed << " s, saved in " << save << " s" << endl;
+        }
     } 
     catch (const exception& e) 
     {
@@ -147,9 +414,122 @@ void print_help()
         "  -f, --text-file=FILE   set the text file to encrypt\n"
         "  -p, --password=PASSWD  set the password\n"
         "  -o, --out-file=FILE    set the output stego-image filename\n"
+        "  -b, --batch=FILE|DIR   steg many images in one run, from a manifest FILE\n"
+        "                         (lines of tab-separated IMAGE PAYLOAD PASSWORD OUTPUT)\n"
+        "                         or every image of DIR with the -f text file and the\n"
+        "                         -p password, saved as PNG in the -o directory, with\n"
+        "                         the -k, -s, -z, -e and -d options; an image whose\n"
+        "                         output would overwrite an input or the output of\n"
+        "                         another image fails\n"
+        "  -j, --jobs=N           number of worker threads per stage in batch mode\n"
+        "  -i, --in-place         hide the text in IMAGE-FILE itself, only the pixels\n"
+        "                         modified are rewritten in PPM, PAM and BMP files\n"
+        "  -r, --redirect         save a stego-image of a lossy format (e.g. WebP) as\n"
+        "                         PNG instead of refusing it\n"
+        "  -V, --verify           decode the stego-image again once saved and check\n"
+        "                         that it holds the text (every image of a batch)\n"
+        "  -C, --capacity         print how many bytes IMAGE-FILE can hide with each\n"
+        "                         number of bits, reading only its header, and whether\n"
+        "                         the -f text fits with the other options; hide nothing\n"
+        "  -k, --bits=N           hide N bits (1 to 4) per color sample instead of 1,\n"
+        "                         for N times more text and less pixels modified\n"
+        "  -s, --scatter          spread the text over the whole image, at places\n"
+        "                         chosen by the password\n"
+        "  -z, --compress=CODEC   compress the text before hiding it, with zlib (or\n"
+        "                         zstd, lz4 when built with them); none by default\n"
+        "  -L, --level=N          compression level of the codec\n"
+        "  -e, --encrypt[=ALG]    encrypt the text with a key derived from the password,\n"
+        "                         with aes-256-gcm or chacha20-poly1305 (by default the\n"
+        "                         one this processor is faster at)\n"
+        "  -d, --digest=ALG       digest of the password hidden in the image: sha1 (the\n"
+        "                         default, read by older versions), sha256 or blake2b\n"
+        "  -P, --png=PRESET       how a PNG stego-image is encoded: default (as OpenCV),\n"
+        "                         fastest (not compressed), fast or small, see README.md\n"
+        "                         for their speed and size\n"
+        "      --png-level=N      zlib level of the PNG, from 0 (stored) to 9\n"
+        "      --png-filter=F     filter of its rows: none, sub, up, average, paeth or\n"
+        "                         adaptive\n"
+        "      --png-threads=N    threads compressing it, 0 for one per core\n"
+        "                         (the other options override the preset)\n"
+        "  For the fastest lossless output use PPM, PAM or BMP (uncompressed).\n"
+        "  A JPEG image saved as JPEG hides the text in its DCT coefficients and\n"
+        "  stays about the same size (1 bit per coefficient, no -k or -s).\n"
         "\n"
         "  If a text file is not provided by options, the program will take\n"
         "  the text from STDIN.\n";
 }   // 'print_help()' closed.
 
+//========================= run_batch() =======================================
+int run_batch(const string& batch, const string& text_filename, const string& key, const string& out_dir,
+              unsigned jobs, bool verify, const StegOptions& options)
+{
+    vector<BatchItem> items;
+    struct stat st;
+
+    try
+    {
+        if (stat(batch.c_str(), &st) == 0 and S_ISDIR(st.st_mode))
+        {
+            if (text_filename.empty() or key.empty())
+                error("Options -f and -p are required to steg a directory");
+
+            items = Batch::directory(batch, text_filename, key, out_dir, Batch::STEG);
+        }
+        else
+        {
+            items = Batch::manifest(batch, Batch::STEG);
+        }
+    }
+    catch (const exception& e)
+    {
+        error(e);
+    }
+
+    Batch b(Batch::STEG, jobs);
+    b.set_verify(verify);
+    b.set_options(options);
+    BatchSummary summary = b.run(items, cout);
 
+    return (summary.failed == 0) ? 0 : 1;
+}   // 'run_batch()' closed.
+
+//========================= print_capacity() ==================================
+int print_capacity(const string& image_filename, const string& text_filename, const StegOptions& options)
+{
+    try
+    {
+        capacity::Carrier c = capacity::probe(image_filename, true);
+        cout << ":: " << c.cols << "x" << c.rows << ", " << c.channels << " channel(s) of " << c.bps << " bits"
+             << (c.decoded ? " (decoded)" : " (from the header)") << endl;
+
+        StegOptions o = options;
+        for (o.depth = 1; o.depth <= 4; ++o.depth)
+            cout << ":: Capacity with " << o.depth << " bit(s) per sample: " << capacity::capacity(c, o) << " bytes"
+                 << endl;
+
+        // The coefficients were read by 'probe()', but not decoded to pixels
+        o.depth = 1;
+        if (c.coefficients)
+            cout << ":: Capacity in the DCT coefficients (saved as JPEG): " << capacity::capacity(c, o, true)
+                 << " bytes" << endl;
+
+        if (not text_filename.empty())
+        {
+            ifstream file(text_filename.c_str(), ios::binary);
+            if (not file)
+                error("Can't open the text file '" + text_filename + "'");
+
+            string text((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+            uint64_t stored = capacity::packed(reinterpret_cast<const uint8_t *>(text.data()), text.size(), options);
+            bool fits = stored <= capacity::capacity(c, options);
+            cout << ":: Text of " << text.size() << " bytes stored as " << stored << " bytes, it "
+                 << (fits ? "fits" : "does not fit") << " with the options given" << endl;
+        }
+    }
+    catch (const exception& e)
+    {
+        error(e);
+    }
+
+    return 0;
+}   // 'print_capacity()' closed.
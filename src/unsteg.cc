@@ -7,9 +7,13 @@
 
 #include <iostream>
 #include <string>
+#include <fstream>
+#include <cstdlib>
 #include <getopt.h>
+#include <sys/stat.h>
 #include "MatImage.h"
-#include "TextFile.h"
+#include "JpegImage.h"
+#include "Batch.h"
 #include "Error.h"
 
 using namespace std;
@@ -20,6 +24,7 @@ const string PROGRAM = "unsteg";
 
 // Helper functions
 void print_help();
+int run_batch(const string& batch, const string& key, const string& out_dir, unsigned jobs);
 
 //==================== main() ===================================================
 int main(int argc, char** argv)
@@ -29,6 +34,10 @@ int main(int argc, char** argv)
     string text;
     string key;
     string out_filename;
+    string batch;
+    unsigned jobs = 0;
+    uint64_t offset = 0, length = 0;
+    bool range = false;
 
     // Command-line options
     int option_index = 0;
@@ -36,13 +45,17 @@ int main(int argc, char** argv)
         {"help",      no_argument,       0, 'h'},
         {"password",  required_argument, 0, 'p'},
         {"out-file",  required_argument, 0, 'o'},
+        {"batch",     required_argument, 0, 'b'},
+        {"jobs",      required_argument, 0, 'j'},
+        {"offset",    required_argument, 0, 'O'},
+        {"length",    required_argument, 0, 'n'},
         {0,0,0,0}
     };
 
     // Parse every options
     while (true)
     {
-        int c = getopt_long(argc, argv, ":hp:o:", long_options, &option_index);
+        int c = getopt_long(argc, argv, ":hp:o:b:j:O:n:", long_options, &option_index);
 
         // If parsing complete, break out of loop
         if (c == -1) break;
@@ -61,6 +74,23 @@ int main(int argc, char** argv)
                 out_filename = string(optarg);
                 break;
 
+            case 'b':
+                batch = string(optarg);
+                break;
+
+            case 'j':
+                jobs = static_cast<unsigned>(atoi(optarg));
+                break;
+
+            case 'O':
+                offset = strtoull(optarg, NULL, 10);
+                break;
+
+            case 'n':
+                length = strtoull(optarg, NULL, 10);
+                range = true;
+                break;
+
             case ':':
                 error("Missing option argument");
 
@@ -72,6 +102,20 @@ int main(int argc, char** argv)
         }   // 'switch (c)' closed.
     }   // 'while (true)' closed.
 
+    if (offset > 0 and not range)
+        error("Option -O needs the number of bytes to extract (-n)");
+
+    // Batch mode, from a manifest or a directory
+    if (not batch.empty())
+    {
+        if (argc != optind)
+        {
+            print_help();
+            return 1;
+        }
+        return run_batch(batch, key, out_filename.empty() ? "." : out_filename, jobs);
+    }
+
     // There should be exactly 1 non-option argument
     if ( (argc - optind) != 1 )
     {
@@ -79,12 +123,17 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    // Open the image
+    // Open the image, its rows are decoded only as far as the hidden text goes
     image_filename = string(argv[optind++]);
     MatImage I;
+    unique_ptr<JpegImage> jpeg;
     try
     {
-        I = image_filename;
+        // A JPEG image hides the text in its DCT coefficients
+        if (JpegImage::supported(image_filename))
+            jpeg.reset(new JpegImage(image_filename));
+        else
+            I = MatImage::stream(image_filename);
     } 
     catch (const IOError& e)
     {
@@ -98,19 +147,50 @@ int main(int argc, char** argv)
         getline(cin, key);
     }
 
-    // Unsteg
-    TextFile file;
+    // Unsteg, the hidden text (or binary file) is written as it is read
     try 
     {
-        file = I.unsteg(key);
+        if (jpeg)
+        {
+            // The text is read from the coefficients as a whole
+            text = jpeg->unsteg(KeySchedule(key));
+            if (range)
+            {
+                if (offset > text.size() or length > text.size() - offset)
+                    throw RangeError();
+                text = text.substr(static_cast<size_t>(offset), static_cast<size_t>(length));
+            }
+        }
+        else if (range)
+        {
+            // Only the bytes asked for are read
+            text = I.unsteg_range(key, offset, length);
+        }
 
-        if (out_filename.empty()) 
+        if (jpeg or range)
         {
-            cout << file << endl;
+            if (out_filename.empty())
+                cout << text << endl;
+            else
+            {
+                ofstream file(out_filename.c_str(), ios::binary);
+                if (not (file and file.write(text.data(), text.size())))
+                    error("Can't write the output file '" + out_filename + "'");
+                cout << ":: Hidden text extracted to '" << out_filename <<"'" << endl;
+            }
+        }
+        else if (out_filename.empty()) 
+        {
+            I.unsteg(key, cout);
+            cout << endl;
         } 
         else 
         {
-            file.save(out_filename);
+            ofstream file(out_filename.c_str(), ios::binary);
+            if (not file)
+                error("Can't open the output file '" + out_filename + "'");
+
+            I.unsteg(key, file);
             cout << ":: Hidden text extracted to '" << out_filename <<"'" << endl;
         }
     }
@@ -133,5 +213,42 @@ void print_help()
         "OPTIONS:\n"
         "  -h, --help               display this help message\n"
         "  -p, --password=PASSWD    password to decrypt\n"
-        "  -o, --out-file=FILE      output filename\n";
+        "  -o, --out-file=FILE      output filename\n"
+        "  -b, --batch=FILE|DIR     unsteg many images in one run, from a manifest FILE\n"
+        "                           (lines of tab-separated IMAGE PASSWORD OUTPUT) or\n"
+        "                           every image of DIR with the -p password, extracted\n"
+        "                           as .txt files in the -o directory\n"
+        "  -j, --jobs=N             number of worker threads per stage in batch mode\n"
+        "  -n, --length=N           extract only N bytes of the hidden text, from the\n"
+        "  -O, --offset=N           byte N (0 by default)\n";
 }   // 'print_help()' closed.
+
+//========================= run_batch() =======================================
+int run_batch(const string& batch, const string& key, const string& out_dir, unsigned jobs)
+{
+    vector<BatchItem> items;
+    struct stat st;
+
+    try
+    {
+        if (stat(batch.c_str(), &st) == 0 and S_ISDIR(st.st_mode))
+        {
+            if (key.empty())
+                error("Option -p is required to unsteg a directory");
+
+            items = Batch::directory(batch, "", key, out_dir, Batch::UNSTEG);
+        }
+        else
+        {
+            items = Batch::manifest(batch, Batch::UNSTEG);
+        }
+    }
+    catch (const exception& e)
+    {
+        error(e);
+    }
+
+    BatchSummary summary = Batch(Batch::UNSTEG, jobs).run(items, cout);
+
+    return (summary.failed == 0) ? 0 : 1;
+}   // 'run_batch()' closed.
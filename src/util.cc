@@ -3,8 +3,9 @@
  *  This file defines the utlity function declared in `util.h` file.
  */
 #include "util.h"
+#include "Hash.h"
 #include <sstream>
-#include <openssl/sha.h>
+#include <openssl/crypto.h>
 #include <cassert>
 #include <iomanip>
 #include <iostream>
@@ -20,17 +21,24 @@ namespace Steganography
 // Returns a SHA-1 digest of the given string
 string sha(const string& in)
 	{
-  	  uchar temp[SHA_DIGEST_LENGTH]; // SHA_DIGEST_LENGTH = 20 bytes
+		// Kept for the callers wanting a string, the digest itself is computed by 'sha1()'
+		Digest d = sha1(in);
+		return string(d.begin(), d.end());
+	}  // 'sha(const string& in)' closed.
 
-    	// This is the library function, declared in <openssl/sha.h>
-    	// See 'man 3 sha' for details.
-    	SHA1((uchar*) in.c_str(), in.size(), temp);
+// Returns a SHA-1 digest of the given string, on the stack
+Digest sha1(const string& in)
+	{
+		// Through the reusable EVP context of the thread, see 'Hash.h'
+		return hashing::compute(hashing::SHA1, in.data(), in.size());
+	}  // 'sha1(const string& in)' closed.
 
-    	string s;
-    	for (int i = 0; i < SHA_DIGEST_LENGTH; ++i)
-    	    s.push_back(temp[i]);
-    	return s;
-	}  // 'sha(const string& in)' closed.
+// Constant-time comparison of two digests
+bool same(const Digest& a, const Digest& b)
+	{
+		// Every byte is compared whatever the result, so the time does not tell how much of a guess is right
+		return CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+	}  // 'same(const Digest& a, const Digest& b)' closed.
 
 
 // Sets a bit
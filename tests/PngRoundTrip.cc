@@ -0,0 +1,126 @@
+/**
+ * Regression test of 'RowWriter' for PNG files deflated on many threads.
+ * The file is read back with libpng up to 'png_read_end()', which checks the CRC of every chunk up to IEND, and its
+ * pixels are compared with the rows encoded. Returns 0 if the file is the same for every setting.
+ */
+
+#include <cstdio>
+#include <csetjmp>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <png.h>
+#include "RowWriter.h"
+#include "Error.h"
+
+using namespace std;
+using namespace Steganography;
+
+namespace
+{
+	// Rows of noise, so the deflated blocks are not all alike
+	vector<uint8_t> pattern(int cols, int rows)
+		{
+			vector<uint8_t> pixels(3*static_cast<size_t>(cols)*rows);
+			uint32_t x = 2463534242u;
+			for(size_t i = 0; i < pixels.size(); ++i)
+				{
+					x ^= x << 13;
+					x ^= x >> 17;
+					x ^= x << 5;
+					pixels[i] = static_cast<uint8_t>((i % 97) + (x & 15));
+				}
+			return pixels;
+		}
+
+	// Reads a PNG file with libpng to its end, returns false on any error
+	bool read(const string& filename, int cols, int rows, vector<uint8_t>& pixels)
+		{
+			FILE* file = fopen(filename.c_str(), "rb");
+			if(not file)
+				return false;
+
+			png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+			png_infop info = png_create_info_struct(png);
+			vector<png_bytep> lines(rows);
+			bool ok = false;
+
+			if(setjmp(png_jmpbuf(png)) == 0)
+				{
+					png_init_io(png, file);
+					png_read_info(png, info);
+
+					if(static_cast<int>(png_get_image_width(png, info)) == cols
+					   and static_cast<int>(png_get_image_height(png, info)) == rows
+					   and png_get_color_type(png, info) == PNG_COLOR_TYPE_RGB and png_get_bit_depth(png, info) == 8)
+						{
+							pixels.assign(3*static_cast<size_t>(cols)*rows, 0);
+							for(int r = 0; r < rows; ++r)
+								lines[r] = pixels.data() + 3*static_cast<size_t>(cols)*r;
+
+							png_read_image(png, lines.data());
+							png_read_end(png, NULL);
+							ok = true;
+						}
+				}
+
+			png_destroy_read_struct(&png, &info, NULL);
+			fclose(file);
+			return ok;
+		}
+
+	// Encodes the pattern with the settings and reads it back
+	bool round_trip(const string& filename, int cols, int rows, const PngSettings& settings)
+		{
+			vector<uint8_t> pixels = pattern(cols, rows), back;
+
+			shared_ptr<RowWriter> writer = RowWriter::open(filename, cols, rows, RGB, settings);
+			if(not writer)
+				return false;
+
+			// A few rows at a time, as 'Pipeline' does
+			for(int r = 0; r < rows; r += 7)
+				writer->encode(pixels.data() + 3*static_cast<size_t>(cols)*r, 3*static_cast<size_t>(cols), 7);
+			writer.reset();
+
+			bool ok = read(filename, cols, rows, back) and back == pixels;
+			remove(filename.c_str());
+			return ok;
+		}
+
+}	// Unnamed namespace closed.
+
+int main()
+	{
+		const string filename = "PngRoundTrip.png";
+		const char* presets[] = { "default", "fastest", "fast", "small" };
+		int failures = 0;
+
+		for(unsigned threads : { 1u, 2u, 4u })
+			for(const char* name : presets)
+				for(int cols : { 81, 640 })
+					{
+						PngSettings settings = PngSettings::preset(name);
+						settings.threads = threads;
+
+						bool ok = false;
+						try
+							{
+								ok = round_trip(filename, cols, 481, settings);
+							}
+						catch(const Error& e)
+							{
+								cerr << e.what() << endl;
+							}
+
+						if(not ok)
+							{
+								cerr << " FAILED : preset '" << name << "', " << threads << " threads, " << cols
+									 << " columns" << endl;
+								++failures;
+							}
+					}
+
+		cout << ((failures == 0) ? " PngRoundTrip passed" : " PngRoundTrip failed") << endl;
+		return (failures == 0) ? 0 : 1;
+	}
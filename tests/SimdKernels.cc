@@ -0,0 +1,113 @@
+/**
+ * Test of the vector kernels of 'simd.h' against the scalar ones of 'bitplane.h'.
+ * Random samples and bytes are hidden and read with every instruction set the processor supports, for keys of
+ * several periods, both channel orders, every shift and counts that are not a multiple of a vector step, and must
+ * give the same samples and bytes as 'bitplane::scatter()' and 'bitplane::gather()'. Returns 0 if they all do.
+ */
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <random>
+#include <iostream>
+#include "simd.h"
+#include "bitplane.h"
+#include "KeySchedule.h"
+
+using namespace std;
+using namespace Steganography;
+
+namespace
+{
+	// The samples once the bytes are hidden by 'bitplane::scatter()', from the position 'k' of the key
+	template<ChannelOrder O>
+	void scatter(vector<uint8_t>& s, const vector<uint8_t>& bytes, const KeySchedule& ks, size_t k, unsigned shift)
+		{
+			for(size_t n = 0; n < bytes.size(); ++n)
+				{
+					const KeySchedule::Entry& e = ks[(k + n) % ks.period()];
+					bitplane::scatter<O>(s.data() + 9*n, bytes[n], e.ignore, e.planes, shift);
+				}
+		}
+
+	// The bytes read by 'bitplane::gather()'
+	template<ChannelOrder O>
+	vector<uint8_t> gather(const vector<uint8_t>& s, size_t count, const KeySchedule& ks, size_t k, unsigned shift)
+		{
+			vector<uint8_t> bytes(count);
+			for(size_t n = 0; n < count; ++n)
+				{
+					const KeySchedule::Entry& e = ks[(k + n) % ks.period()];
+					bytes[n] = bitplane::gather<O>(s.data() + 9*n, e.ignore, e.planes, shift);
+				}
+			return bytes;
+		}
+
+	// Compares the kernels in use with the scalar ones for one case, returns false if they differ
+	bool same(const KeySchedule& ks, size_t count, size_t k, ChannelOrder order, unsigned shift, mt19937& random)
+		{
+			vector<uint8_t> samples(9*count), bytes(count);
+			for(uint8_t& x : samples)
+				x = static_cast<uint8_t>(random());
+			for(uint8_t& x : bytes)
+				x = static_cast<uint8_t>(random());
+
+			// Reading samples that hide nothing
+			vector<uint8_t> read(count);
+			simd::extract(samples.data(), read.data(), count, ks, k, order, shift);
+			bool ok = read == ((order == BGR) ? gather<BGR>(samples, count, ks, k, shift)
+											  : gather<RGB>(samples, count, ks, k, shift));
+
+			// Hiding, then reading back
+			vector<uint8_t> expected = samples;
+			if(order == BGR)
+				scatter<BGR>(expected, bytes, ks, k, shift);
+			else
+				scatter<RGB>(expected, bytes, ks, k, shift);
+
+			simd::embed(samples.data(), bytes.data(), count, ks, k, order, shift);
+			simd::extract(samples.data(), read.data(), count, ks, k, order, shift);
+
+			return ok and samples == expected and read == bytes;
+		}
+
+}	// Unnamed namespace closed.
+
+int main()
+	{
+		const simd::Level levels[] = { simd::SCALAR, simd::SSE41, simd::AVX2 };
+		const char* keys[] = { "a", "ab", "hunter2", "123456789", "a long key with spaces 17", "p\xc3\xa4ssw\xc3\xb6rd" };
+		const size_t counts[] = { 1, 7, 15, 16, 17, 31, 33, 63, 65, 101, 1001 };
+		mt19937 random(2019);
+		int failures = 0;
+
+		for(simd::Level level : levels)
+			{
+				if(simd::use(level) != level)
+					{
+						cout << " " << simd::name(level) << " is not supported, skipped" << endl;
+						continue;
+					}
+
+				for(const char* key : keys)
+					{
+						KeySchedule ks(key);
+						const size_t starts[] = { 0, 1 % ks.period(), ks.period() / 2, ks.period() - 1 };
+
+						for(size_t count : counts)
+							for(size_t k : starts)
+								for(ChannelOrder order : { RGB, BGR })
+									for(unsigned shift = 0; shift < 4; ++shift)
+										if(not same(ks, count, k, order, shift, random))
+											{
+												cerr << " FAILED : " << simd::name(level) << ", key '" << key << "', "
+													 << count << " bytes from " << k << ", "
+													 << ((order == BGR) ? "BGR" : "RGB") << ", shift " << shift << endl;
+												++failures;
+											}
+					}
+			}
+
+		cout << ((failures == 0) ? " SimdKernels passed" : " SimdKernels failed") << endl;
+		return (failures == 0) ? 0 : 1;
+	}
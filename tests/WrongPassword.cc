@@ -0,0 +1,125 @@
+/**
+ * Test of the key check of an encrypted text, see 'MatImage::set_encryption()'.
+ * The header of an encrypted text must not be readable with the key schedule of its password alone, which is cheap
+ * to build and would let a password be checked without the key derivation, while it is for a text in clear. A wrong
+ * password, even one with the same key schedule, must then be refused and the right one read the text back.
+ * Returns 0 if they all are.
+ */
+
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <iostream>
+#include "MatImage.h"
+#include "KeySchedule.h"
+#include "Header.h"
+#include "simd.h"
+#include "Error.h"
+
+using namespace std;
+using namespace Steganography;
+
+namespace
+{
+	const int COLS = 240, ROWS = 60;
+
+	// Pixels of noise
+	vector<uint8_t> noise()
+		{
+			vector<uint8_t> pixels(3*COLS*ROWS);
+			uint32_t x = 2463534242u;
+			for(uint8_t& p : pixels)
+				{
+					x ^= x << 13;
+					x ^= x >> 17;
+					x ^= x << 5;
+					p = static_cast<uint8_t>(x);
+				}
+			return pixels;
+		}
+
+	// Whether the header at the start of the second row is readable with the key schedule of 'key' alone
+	bool readable(const vector<uint8_t>& pixels, const string& key)
+		{
+			KeySchedule ks(key);
+			uint8_t bytes[Header::SIZE];
+			simd::extract(pixels.data() + 3*COLS, bytes, Header::SIZE, ks, ks.phase(0));
+
+			Header h;
+			try
+				{
+					return h.read(bytes);
+				}
+			catch(const Error&)
+				{
+					return false;
+				}
+		}
+
+	// Whether unstegging with 'key' is refused as a wrong password
+	bool refused(const MatImage& image, const string& key)
+		{
+			try
+				{
+					image.unsteg(key);
+				}
+			catch(const KeyMismatchError&)
+				{
+					return not image.is_stego(key);
+				}
+			catch(const Error&)
+				{
+				}
+			return false;
+		}
+
+	// Hides a text with the password "ab" and checks it, returns the number of checks that failed
+	int check(crypto::Algorithm cipher)
+		{
+			const string text = "The text hidden, encrypted with " + crypto::name(cipher);
+			vector<uint8_t> pixels = noise();
+			MatImage image(pixels.data(), COLS, ROWS, 3*COLS, RGB);
+			image.set_encryption(cipher);
+			image.steg(text, "ab");
+
+			int failures = 0;
+			auto expect = [&](bool ok, const string& what)
+				{
+					if(not ok)
+						{
+							cerr << " FAILED : " << crypto::name(cipher) << ", " << what << endl;
+							++failures;
+						}
+				};
+
+			// "abab" has the same key schedule as "ab", so only the derived key tells them apart
+			expect(not readable(pixels, "ab"), "the header is readable without the key derivation");
+			expect(refused(image, "abab"), "a wrong password with the same key schedule is not refused");
+			expect(refused(image, "hunter2"), "a wrong password is not refused");
+			expect(image.is_stego("ab") and image.unsteg("ab") == text, "the right password does not read the text");
+
+			return failures;
+		}
+
+}	// Unnamed namespace closed.
+
+int main()
+	{
+		int failures = 0;
+
+		// The header of a text in clear is read with the key schedule, which tells the test reads the right place
+		vector<uint8_t> pixels = noise();
+		MatImage image(pixels.data(), COLS, ROWS, 3*COLS, RGB);
+		image.steg("The text hidden in clear", "ab");
+		if(not readable(pixels, "ab"))
+			{
+				cerr << " FAILED : the header of a text in clear is not readable" << endl;
+				++failures;
+			}
+
+		failures += check(crypto::AES_256_GCM);
+		failures += check(crypto::CHACHA20_POLY1305);
+
+		cout << ((failures == 0) ? " WrongPassword passed" : " WrongPassword failed") << endl;
+		return (failures == 0) ? 0 : 1;
+	}